@@ -1,113 +1,110 @@
 #pragma once
-#include <iostream>
-#include <map>
-#include <mutex>
+#include "platform.hpp"
 #include <memory>
 #include <vector>
 
+// Results of a scan addressed by region index. Keys are dense, so the values sit in a flat vector of slots.
+// Slots are sized up front with reserve_keys, after which every task fills its own slot and no call takes a lock.
+// Insertions beyond the reserved keys grow the vector and must not run concurrently with anything else.
 template<typename T>
 class custom_map {
 private:
-    std::map<int32_t, std::shared_ptr<T>> _map;
-    mutable std::mutex _mutex;
+    std::vector<std::shared_ptr<T>> _slots;
+
+    __forceinline bool holds(int32_t key) const {
+        return key >= 0 && static_cast<size_t>(key) < _slots.size() && _slots[key];
+    }
 
 public:
     custom_map() = default;
+    explicit custom_map(size_t keys) : _slots(keys) {}
 
     // Disable copy operations
     custom_map(const custom_map&) = delete;
     custom_map& operator=(const custom_map&) = delete;
 
-    // Move constructor
-    custom_map(custom_map&& other) noexcept {
-        std::lock_guard<std::mutex> lock(other._mutex);
-        _map = std::move(other._map);
-    }
+    custom_map(custom_map&& other) noexcept = default;
+    custom_map& operator=(custom_map&& other) noexcept = default;
 
-    // Move assignment
-    custom_map& operator=(custom_map&& other) noexcept {
-        if (this != &other) {
-            std::scoped_lock lock(_mutex, other._mutex);
-            _map = std::move(other._map);
-        }
-        return *this;
+    // Makes room for the keys [0, keys), so tasks can insert them concurrently.
+    void reserve_keys(size_t keys) {
+        if (keys > _slots.size())
+            _slots.resize(keys);
     }
 
     // Insert element
     void insert(int32_t key, std::shared_ptr<T> value) {
-        std::lock_guard<std::mutex> lock(_mutex);
-        _map[key] = std::move(value);
+        reserve_keys(static_cast<size_t>(key) + 1);
+        _slots[key] = std::move(value);
     }
 
     // Remove element
     bool erase(int32_t key) {
-        std::lock_guard<std::mutex> lock(_mutex);
-        return _map.erase(key) > 0;
+        if (!holds(key))
+            return false;
+
+        _slots[key].reset();
+        return true;
     }
 
     // Check if key exists
     bool contains(int32_t key) const {
-        std::lock_guard<std::mutex> lock(_mutex);
-        return _map.find(key) != _map.end();
+        return holds(key);
     }
 
-    // Access element by key
-    std::shared_ptr<T> at(int32_t key) const {
-        std::lock_guard<std::mutex> lock(_mutex);
-        auto it = _map.find(key);
-        if (it == _map.end())
-            return nullptr;
-        return it->second;
+    // Access element by key, null when the key holds nothing.
+    const std::shared_ptr<T>& at(int32_t key) const {
+        static const std::shared_ptr<T> none;
+        return holds(key) ? _slots[key] : none;
     }
 
     // Get the first element (if exists)
     std::shared_ptr<T> first() const {
-        std::lock_guard<std::mutex> lock(_mutex);
-        if (_map.empty())
-            return nullptr;
-        return _map.begin()->second;
+        for (auto& slot : _slots) {
+            if (slot)
+                return slot;
+        }
+        return nullptr;
     }
 
-    // Apply function to each element
+    // Apply function to each element, in key order
     template<typename Func>
     void for_each(Func func) const {
-        std::lock_guard<std::mutex> lock(_mutex);
-        for (const auto& pair : _map) {
-            func(pair.first, pair.second);
+        for (size_t key = 0; key < _slots.size(); key++) {
+            if (_slots[key])
+                func(static_cast<int32_t>(key), _slots[key]);
         }
     }
 
     // Check if map is empty
     bool empty() const {
-        std::lock_guard<std::mutex> lock(_mutex);
-        return _map.empty();
+        return size() == 0;
     }
 
-    // Get map size
+    // Number of keys holding a value
     size_t size() const {
-        std::lock_guard<std::mutex> lock(_mutex);
-        return _map.size();
+        size_t count = 0;
+        for (auto& slot : _slots)
+            count += slot != nullptr;
+        return count;
     }
 
     // Get a copy of all keys
     std::vector<int32_t> keys() const {
-        std::lock_guard<std::mutex> lock(_mutex);
         std::vector<int32_t> result;
-        result.reserve(_map.size());
-        for (const auto& pair : _map) {
-            result.push_back(pair.first);
-        }
+        for_each([&](int32_t key, const std::shared_ptr<T>&) { result.push_back(key); });
         return result;
     }
 
     // Get a copy of all values
     std::vector<std::shared_ptr<T>> values() const {
-        std::lock_guard<std::mutex> lock(_mutex);
         std::vector<std::shared_ptr<T>> result;
-        result.reserve(_map.size());
-        for (const auto& pair : _map) {
-            result.push_back(pair.second);
-        }
+        for_each([&](int32_t, const std::shared_ptr<T>& value) { result.push_back(value); });
         return result;
     }
-};
\ No newline at end of file
+
+    // Exchanges the results of two generations without touching their slots.
+    void swap(custom_map& other) noexcept {
+        _slots.swap(other._slots);
+    }
+};
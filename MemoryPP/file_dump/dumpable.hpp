@@ -5,7 +5,8 @@
 #include <memory>
 #include <optional>
 
-template <typename Header, typename DataType>
+// Buffer holds the data in memory, any contiguous container with the resize, clear and shrink_to_fit of std::vector.
+template <typename Header, typename DataType, typename Buffer = std::vector<DataType>>
 class dumpable {
 protected:
     Header _header{};
@@ -13,7 +14,7 @@ protected:
     std::optional<uint64_t> _file_offset{ 0 };
 
     std::span<DataType> _data_map; // READ ONLY  
-    std::vector<DataType> _data;
+    Buffer _data;
 
     std::unique_ptr<mapped_chunk> _mapped_info;
     bool _valid{ false };
@@ -58,13 +59,29 @@ public:
         }
     }
 
+    __forceinline bool is_valid() const { return _valid; }
+
+    // Contiguous view of the data, mapped back from the file if it was discarded.
+    std::span<DataType> view() {
+        if (!_valid)
+            return std::span<DataType>();
+
+        if (!_discarded)
+            return std::span<DataType>(_data);
+
+        if (!_mapped_info && !load())
+            return std::span<DataType>();
+
+        return _data_map;
+    }
+
     bool load();
 
     bool dump(bool discard_memory = false);
 };
 
-template<typename Header, typename DataType>
-inline bool dumpable<Header, DataType>::load() {
+template<typename Header, typename DataType, typename Buffer>
+inline bool dumpable<Header, DataType, Buffer>::load() {
     if (!_data_map.empty())
         return true;
 
@@ -79,8 +96,8 @@ inline bool dumpable<Header, DataType>::load() {
     return false;
 }
 
-template<typename Header, typename DataType>
-inline bool dumpable<Header, DataType>::dump(bool discard_memory) {
+template<typename Header, typename DataType, typename Buffer>
+inline bool dumpable<Header, DataType, Buffer>::dump(bool discard_memory) {
     if (_data.empty())
         return false; 
 
@@ -1,6 +1,8 @@
 #pragma once
-#include <windows.h>
+#include "../platform.hpp"
+#ifdef _WIN32
 #include <tlhelp32.h>
+#endif
 #include <vector>
 #include <cstdint>
 #include <string>
@@ -12,6 +14,7 @@
 #include <mutex>
 #include <optional>
 
+#ifdef _WIN32
 // RAII wrapper per HANDLE.
 class unique_handle {
 public:
@@ -46,6 +49,7 @@ public:
 private:
     HANDLE handle_ = INVALID_HANDLE_VALUE;
 };
+#endif
 
 // File header usato per il file dump.
 struct file_header {
@@ -54,13 +58,17 @@ struct file_header {
 };
 
 struct mapped_chunk {
-    LPVOID view_base;        // Base pointer returned by MapViewOfFile (used for unmapping)
-    LPVOID pointer;          // Pointer to the mapped chunk (may differ from view_base due to alignment)
+    void* view_base;         // Base pointer returned by MapViewOfFile / mmap (used for unmapping)
+    void* pointer;           // Pointer to the mapped chunk (may differ from view_base due to alignment)
     size_t view_size;        // Total size of the mapped view (including alignment offset)
     uint64_t map_offset;     // Aligned offset used for mapping (multiple of system granularity)
     size_t chunk_size;       // The actual requested size (i.e., header + region data)
+#ifdef _WIN32
     HANDLE file_handle;      // Handle to the opened file
     HANDLE mapping_handle;   // Handle to the mapping object
+#else
+    int file_descriptor;     // Descriptor of the opened file
+#endif
 
     mapped_chunk() = default;
 
@@ -86,12 +94,14 @@ private:
     std::string _file_name;
     size_t _current_size{ 0 };
     std::mutex _mutex;
+    std::mutex _size_mutex;     // Guards _current_size and the growth of the file, map_file runs with or without _mutex.
 
     std::vector<uint8_t> _buffer;
     size_t _buffer_pos{ 0 };
 
 private:
      std::unique_ptr<mapped_chunk>      map_file(const uint64_t& offset, const size_t& size);
+     // Expects _mutex to be held by the caller.
      bool                               write_file(uint64_t offset, const uint8_t* buffer, const size_t& size);
 
 public:
@@ -1,3 +1,4 @@
+#ifdef _WIN32
 #include "../file_dump.hpp"
 
 mapped_chunk::~mapped_chunk()
@@ -74,11 +75,24 @@ std::unique_ptr<mapped_chunk> file_dump::map_file(const uint64_t& offset, const
 
     uint64_t required_size = offset + size;
 
-    if (_current_size < required_size) {
-        LARGE_INTEGER new_size;
-        new_size.QuadPart = required_size;
-        if (!SetFilePointerEx(file_handle.get(), new_size, nullptr, FILE_BEGIN) || !SetEndOfFile(file_handle.get())) {
-            return nullptr;
+    {
+        // Reads map without _mutex while a write may be growing the file, it is only ever extended.
+        std::lock_guard<std::mutex> lock(_size_mutex);
+
+        if (_current_size < required_size) {
+            LARGE_INTEGER file_size;
+
+            if (!GetFileSizeEx(file_handle.get(), &file_size)) {
+                return nullptr;
+            }
+
+            if (static_cast<uint64_t>(file_size.QuadPart) < required_size) {
+                LARGE_INTEGER new_size;
+                new_size.QuadPart = required_size;
+                if (!SetFilePointerEx(file_handle.get(), new_size, nullptr, FILE_BEGIN) || !SetEndOfFile(file_handle.get())) {
+                    return nullptr;
+                }
+            }
         }
     }
 
@@ -130,8 +144,6 @@ std::unique_ptr<mapped_chunk> file_dump::map_file(const uint64_t& offset, const
 
 bool file_dump::write_file(uint64_t offset, const uint8_t* buffer, const size_t& size)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-
     auto chunk = map_file(offset, size);
 
     if (!chunk) {
@@ -145,6 +157,9 @@ bool file_dump::write_file(uint64_t offset, const uint8_t* buffer, const size_t&
     }
 
     uint64_t new_size = offset + size;
+
+    std::lock_guard<std::mutex> lock(_size_mutex);
+
     if (new_size > _current_size) {
         _current_size = new_size;
     }
@@ -180,11 +195,15 @@ file_dump::~file_dump() {
 
 std::unique_ptr<mapped_chunk> file_dump::read(const uint64_t& offset, const size_t& size)
 {
-    if (_buffer_pos > 0) {
-        if (!write_file(get_size(), _buffer.data(), _buffer_pos))
-            return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_buffer_pos > 0) {
+            if (!write_file(get_size(), _buffer.data(), _buffer_pos))
+                return nullptr;
 
-        _buffer_pos = 0;
+            _buffer_pos = 0;
+        }
     }
 
     return std::move(map_file(offset, size));
@@ -193,18 +212,19 @@ std::unique_ptr<mapped_chunk> file_dump::read(const uint64_t& offset, const size
 
 std::optional<uint64_t> file_dump::write(const uint8_t* buffer, const size_t& size)
 {
+    // Regions are dumped from several workers, the buffer and the file size are guarded together.
+    std::lock_guard<std::mutex> lock(_mutex);
+
     std::optional<uint64_t> file_offset = std::nullopt;
 
     if (_buffer_pos + size <= BUFFER_SIZE) {
 
-        std::lock_guard<std::mutex> lock(_mutex);
-
         std::memcpy(_buffer.data() + _buffer_pos, buffer, size);
 
         file_offset = get_size() + _buffer_pos;
 
         _buffer_pos += size;
-        
+
     }
     else {
         if (_buffer_pos > 0) {
@@ -213,21 +233,20 @@ std::optional<uint64_t> file_dump::write(const uint8_t* buffer, const size_t& si
 
             _buffer_pos = 0;
         }
+
+        file_offset = get_size();
+
         if (size > BUFFER_SIZE) {
             if (!write_file(get_size(), buffer, size))
                 return std::nullopt;
         }
         else {
-            std::lock_guard<std::mutex> lock(_mutex);
-
             std::memcpy(_buffer.data(), buffer, size);
 
             _buffer_pos = size;
         }
-
-        file_offset = get_size();
     }
 
     return file_offset;
 }
-
+#endif
@@ -0,0 +1,204 @@
+#ifndef _WIN32
+#include "../file_dump.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+mapped_chunk::~mapped_chunk()
+{
+    if (view_base) {
+        munmap(view_base, view_size);
+    }
+    if (file_descriptor >= 0) {
+        close(file_descriptor);
+    }
+}
+
+mapped_chunk::mapped_chunk(mapped_chunk&& other) noexcept
+    : view_base(other.view_base),
+    pointer(other.pointer),
+    view_size(other.view_size),
+    map_offset(other.map_offset),
+    chunk_size(other.chunk_size),
+    file_descriptor(other.file_descriptor)
+{
+    other.view_base = nullptr;
+    other.pointer = nullptr;
+    other.view_size = 0;
+    other.map_offset = 0;
+    other.chunk_size = 0;
+    other.file_descriptor = -1;
+}
+
+mapped_chunk& mapped_chunk::operator=(mapped_chunk&& other) noexcept
+{
+    if (this != &other) {
+        view_base = other.view_base;
+        pointer = other.pointer;
+        view_size = other.view_size;
+        map_offset = other.map_offset;
+        chunk_size = other.chunk_size;
+        file_descriptor = other.file_descriptor;
+
+        other.view_base = nullptr;
+        other.pointer = nullptr;
+        other.view_size = 0;
+        other.map_offset = 0;
+        other.chunk_size = 0;
+        other.file_descriptor = -1;
+    }
+    return *this;
+}
+
+std::unique_ptr<mapped_chunk> file_dump::map_file(const uint64_t& offset, const size_t& size)
+{
+    int file_descriptor = open(_file_name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (file_descriptor < 0) {
+        return nullptr;
+    }
+
+    uint64_t required_size = offset + size;
+
+    {
+        // Reads map without _mutex while a write may be growing the file, it is only ever extended.
+        std::lock_guard<std::mutex> lock(_size_mutex);
+
+        if (_current_size < required_size) {
+            struct stat file_stat {};
+
+            if (fstat(file_descriptor, &file_stat) != 0 ||
+                (static_cast<uint64_t>(file_stat.st_size) < required_size && ftruncate(file_descriptor, static_cast<off_t>(required_size)) != 0)) {
+                close(file_descriptor);
+                return nullptr;
+            }
+        }
+    }
+
+    uint64_t granularity = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+    // Align the mapping offset to the page size.
+    uint64_t map_offset = (offset / granularity) * granularity;
+    uint64_t offset_diff = offset - map_offset;
+    size_t view_size = offset_diff + size;
+
+    void* view_base = mmap(nullptr, view_size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, static_cast<off_t>(map_offset));
+
+    if (view_base == MAP_FAILED) {
+        close(file_descriptor);
+        return nullptr;
+    }
+
+    auto chunk = std::make_unique<mapped_chunk>();
+    chunk->view_base = view_base;
+    chunk->pointer = static_cast<uint8_t*>(view_base) + offset_diff;
+    chunk->view_size = view_size;
+    chunk->map_offset = map_offset;
+    chunk->chunk_size = size;
+    chunk->file_descriptor = file_descriptor;
+
+    return chunk;
+}
+
+bool file_dump::write_file(uint64_t offset, const uint8_t* buffer, const size_t& size)
+{
+    auto chunk = map_file(offset, size);
+
+    if (!chunk) {
+        return false;
+    }
+
+    std::memcpy(chunk->pointer, buffer, size);
+
+    if (msync(chunk->view_base, chunk->view_size, MS_ASYNC) != 0) {
+        return false;
+    }
+
+    uint64_t new_size = offset + size;
+
+    std::lock_guard<std::mutex> lock(_size_mutex);
+
+    if (new_size > _current_size) {
+        _current_size = new_size;
+    }
+
+    return true;
+}
+
+file_dump::file_dump(const std::string& file_name) : _file_name(file_name) {
+    // Open or create the file.
+    int file_descriptor = open(_file_name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (file_descriptor >= 0) {
+        struct stat file_stat {};
+        if (fstat(file_descriptor, &file_stat) == 0) {
+            _current_size = static_cast<size_t>(file_stat.st_size);
+        }
+        close(file_descriptor);
+    }
+
+    _buffer.resize(BUFFER_SIZE);
+    _buffer_pos = 0;
+}
+
+file_dump::~file_dump() {
+    unlink(_file_name.c_str());
+}
+
+std::unique_ptr<mapped_chunk> file_dump::read(const uint64_t& offset, const size_t& size)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_buffer_pos > 0) {
+            if (!write_file(get_size(), _buffer.data(), _buffer_pos))
+                return nullptr;
+
+            _buffer_pos = 0;
+        }
+    }
+
+    return map_file(offset, size);
+}
+
+
+std::optional<uint64_t> file_dump::write(const uint8_t* buffer, const size_t& size)
+{
+    // Regions are dumped from several workers, the buffer and the file size are guarded together.
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::optional<uint64_t> file_offset = std::nullopt;
+
+    if (_buffer_pos + size <= BUFFER_SIZE) {
+
+        std::memcpy(_buffer.data() + _buffer_pos, buffer, size);
+
+        file_offset = get_size() + _buffer_pos;
+
+        _buffer_pos += size;
+
+    }
+    else {
+        if (_buffer_pos > 0) {
+            if (!write_file(get_size(), _buffer.data(), _buffer_pos))
+                return std::nullopt;
+
+            _buffer_pos = 0;
+        }
+
+        file_offset = get_size();
+
+        if (size > BUFFER_SIZE) {
+            if (!write_file(get_size(), buffer, size))
+                return std::nullopt;
+        }
+        else {
+            std::memcpy(_buffer.data(), buffer, size);
+
+            _buffer_pos = size;
+        }
+    }
+
+    return file_offset;
+}
+#endif
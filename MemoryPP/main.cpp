@@ -1,5 +1,7 @@
-#include <windows.h>
+#include "platform.hpp"
+#ifdef _WIN32
 #include <tlhelp32.h>
+#endif
 #include <vector>
 #include <cstdint>
 #include <string>
@@ -12,6 +14,7 @@
 file_dump memory_dump("dump.bin");
 file_dump results("results.bin");
 
+#ifdef _WIN32
 bool get_main_module_info(DWORD pid, uintptr_t& base_address, SIZE_T& module_size) {
     HANDLE h_snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, pid);
     if (h_snapshot == INVALID_HANDLE_VALUE) {
@@ -33,15 +36,17 @@ bool get_main_module_info(DWORD pid, uintptr_t& base_address, SIZE_T& module_siz
     CloseHandle(h_snapshot);
     return false;
 }
+#endif
 
 
 
 int main() {
 
-    DWORD pid = 0;
+    long pid = 0;
     std::cout << "Enter the process id: " << std::endl;
     std::cin >> pid;
 
+#ifdef _WIN32
     uintptr_t base_address;
     SIZE_T module_size;
 
@@ -62,8 +67,16 @@ int main() {
     auto module_start = reinterpret_cast<LPVOID>(sysInfo.lpMinimumApplicationAddress);
     auto module_end = reinterpret_cast<LPVOID>(sysInfo.lpMaximumApplicationAddress);
 
-    int value = 0;
     auto engine = scan_engine_templated<int>(HandleToLong(h_process));
+#else
+    // The whole user space, the backend only reports mapped regions.
+    auto module_start = reinterpret_cast<void*>(sysconf(_SC_PAGESIZE));
+    auto module_end = reinterpret_cast<void*>(0x800000000000ull);
+
+    auto engine = scan_engine_templated<int>(pid);
+#endif
+
+    int value = 0;
 
     std::cout << "Value to search for: " << std::endl;
     std::cin >> value;
@@ -93,15 +106,15 @@ yes:
         for (auto key : keys) {
             auto result = results->at(key);
 
-            auto elements = result->elements();
-
-            for (auto& elem : elements) {
-                std::cout << "Value: " << elem.value << " Address: " << std::hex << elem.address << std::dec << "\n";
-            }
+            result->for_each_element([](int value, uint64_t address) {
+                std::cout << "Value: " << value << " Address: " << std::hex << address << std::dec << "\n";
+            });
         }
     }
 
+#ifdef _WIN32
     CloseHandle(h_process);
+#endif
     return 0;
 
 
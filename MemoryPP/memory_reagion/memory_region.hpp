@@ -1,5 +1,7 @@
 #pragma once
 #include "../file_dump/dumpable.hpp"
+#include "../process_access/process_access.hpp"
+#include "region_buffer.hpp"
 
 
 extern file_dump memory_dump;
@@ -9,17 +11,53 @@ struct region_header {
     size_t size;    // The size of the memory region (data only)
 };
 
-class memory_region : public dumpable<region_header, uint8_t>
+// Page of a compressed snapshot, either stored in the dump or filled with a single byte.
+struct snapshot_page {
+    static constexpr uint32_t FILLED = UINT32_MAX;
+
+    uint32_t stored;    // Index among the stored pages, FILLED when the page is not stored.
+    uint8_t fill;
+};
+
+// Bytes of a region fetched by a sparse read, offsets are relative to the region base.
+struct region_run {
+    size_t offset;
+    size_t size;
+    size_t buffer_offset;   // Where the run starts in the region buffer.
+    bool valid;
+};
+
+// Data comes from the shared buffer_pool, reads fill it without zeroing it first.
+class memory_region : public dumpable<region_header, uint8_t, region_buffer>
 {
-    MEMORY_BASIC_INFORMATION _mbi;
+    region_info _info;
+
+    // Set when only parts of the region were read, see prepare_sparse_read.
+    std::vector<region_run> _runs;
+
+    // Hash of every page as read, 0 for the pages that were not.
+    std::vector<uint64_t> _page_hashes;
+
+    // One bit per page the target wrote since the previous scan, empty when that is unknown.
+    std::vector<uint64_t> _written_pages;
+
+    // One bit per page backed by memory when the read skipped the others, which hold zeros. Empty when unknown.
+    std::vector<uint64_t> _populated_pages;
+
+    // Set when the region was searched in chunks as it was read, it then holds no data.
+    bool _streamed{ false };
+
+    // Pages of the region once dumped compressed, empty otherwise.
+    std::vector<snapshot_page> _pages;
+    size_t _stored_bytes{ 0 };
 
 public:
 
-    memory_region(const MEMORY_BASIC_INFORMATION& mbi)
-        : _mbi(mbi), dumpable<region_header, uint8_t>(memory_dump)
+    memory_region(const region_info& info)
+        : dumpable<region_header, uint8_t, region_buffer>(memory_dump), _info(info)
     {
-        _header.base = reinterpret_cast<uint64_t>(mbi.BaseAddress);
-        _header.size = mbi.RegionSize;
+        _header.base = info.base;
+        _header.size = info.size;
     }
 
     ~memory_region() = default;
@@ -29,8 +67,15 @@ public:
     memory_region& operator=(const memory_region&) = delete;
 
     memory_region(memory_region&& other) noexcept
-        : dumpable<region_header, uint8_t>(std::move(other))  // Call move constructor of the base class
-        , _mbi(other._mbi)  // Move or copy any additional members specific to memory_region
+        : dumpable<region_header, uint8_t, region_buffer>(std::move(other))  // Call move constructor of the base class
+        , _info(other._info)  // Move or copy any additional members specific to memory_region
+        , _runs(std::move(other._runs))
+        , _page_hashes(std::move(other._page_hashes))
+        , _written_pages(std::move(other._written_pages))
+        , _populated_pages(std::move(other._populated_pages))
+        , _streamed(std::exchange(other._streamed, false))
+        , _pages(std::move(other._pages))
+        , _stored_bytes(std::exchange(other._stored_bytes, 0))
     {
     }
 
@@ -39,14 +84,72 @@ public:
         if (this != &other)
         {
             // Move the base class parts.
-            dumpable<region_header, uint8_t>::operator=(std::move(other));  // Call move assignment operator of the base class
+            dumpable<region_header, uint8_t, region_buffer>::operator=(std::move(other));  // Call move assignment operator of the base class
 
             // Move or copy any additional members specific to memory_region
-            _mbi = other._mbi;
+            _info = other._info;
+            _pages = std::move(other._pages);
+            _stored_bytes = std::exchange(other._stored_bytes, 0);
+            _runs = std::move(other._runs);
+            _page_hashes = std::move(other._page_hashes);
+            _written_pages = std::move(other._written_pages);
+            _populated_pages = std::move(other._populated_pages);
+            _streamed = std::exchange(other._streamed, false);
         }
         return *this;
     }
 
+    static constexpr size_t PAGE_BYTES = 4096;
+
+    // Hashes the pages held in memory, every page of a whole region or those of the runs of a sparse one.
+    // Pages already given a hash keep it. Must run before the data is dumped.
+    void hash_pages();
+
+    // Hashes the pages of size bytes read at offset, which starts a page. Pages already given a hash keep it.
+    void hash_range(const uint8_t* data, size_t offset, size_t size);
+
+    __forceinline uint64_t page_hash(size_t page) const { return page < _page_hashes.size() ? _page_hashes[page] : 0; }
+
+    // For pages copied from a previous region rather than read.
+    void set_page_hash(size_t page, uint64_t hash);
+
+    __forceinline void set_written_pages(std::vector<uint64_t> written) { _written_pages = std::move(written); }
+    __forceinline bool has_written_pages() const { return !_written_pages.empty(); }
+
+    // Pages are assumed written when nothing is known about them.
+    __forceinline bool page_written(size_t page) const {
+        return page / 64 >= _written_pages.size() || ((_written_pages[page / 64] >> (page % 64)) & 1);
+    }
+
+    __forceinline void set_populated_pages(std::vector<uint64_t> populated) { _populated_pages = std::move(populated); }
+    __forceinline bool has_populated_pages() const { return !_populated_pages.empty(); }
+
+    // Pages are assumed populated when nothing is known about them.
+    __forceinline bool page_populated(size_t page) const {
+        return page / 64 >= _populated_pages.size() || ((_populated_pages[page / 64] >> (page % 64)) & 1);
+    }
+
+    // True when the page at address was hashed alike in both regions, so it holds the same bytes in both.
+    static bool same_page(const memory_region& lhs, const memory_region& rhs, uint64_t address);
+
+    // Dumps the region like dump(true), leaving out the pages made of a single repeated byte.
+    // Mostly zero heaps shrink to the few pages actually in use.
+    bool dump_compressed();
+
+    __forceinline bool is_compressed() const { return !_pages.empty(); }
+
+    // Copies the bytes [offset, offset + size) of the region to out, decompressing only the pages they cover.
+    bool read_snapshot(size_t offset, size_t size, uint8_t* out);
+
+    // Compressed regions are expanded in memory as a whole, meant for random access only.
+    bool load();
+
+    // Maps a dumped region back from the file without expanding it. view and read_snapshot map it lazily,
+    // which is not thread safe, so a region read by concurrent tasks is mapped before they start.
+    bool map_snapshot();
+
+    std::span<uint8_t> view();
+
     template <typename DataType>
     DataType* at_offset(size_t offset);
 
@@ -65,20 +168,59 @@ public:
     template <typename F>
     bool read_data(F&& read_func, size_t& bytes_read);
 
+    // Split form of read_data, used when many regions are read with a single batched call.
+    // prepare_read sizes the buffer and returns the request to hand to the reader.
+    read_request prepare_read();
+    bool complete_read(const read_request& request);
+
+    // Sparse form of the above, only the (offset, size) runs are read, packed one after the other in the buffer.
+    // Runs must be sorted and disjoint. The region then exposes runs() instead of view().
+    std::vector<read_request> prepare_sparse_read(std::span<const std::pair<size_t, size_t>> runs);
+    bool complete_sparse_read(std::span<const read_request> requests);
+
+    // Streamed form, the region is read and searched a chunk at a time and never held whole.
+    // The region is valid from then on, chunks are hashed through hash_range as they are read.
+    void begin_stream();
+
+    __forceinline bool is_streamed() const { return _streamed; }
+
+    // Readies a region of the previous scan for a new one over the same memory, see scan_engine::get_regions.
+    // The buffer and the page vectors keep their storage, everything read into them is dropped.
+    void reuse(const region_info& info);
+
+    // Hands the buffer back to the pool, the region then holds no data.
+    void release_buffer();
+
+    __forceinline size_t buffer_capacity() const { return _data.capacity(); }
+
+    __forceinline bool is_sparse() const { return !_runs.empty(); }
+    __forceinline std::span<const region_run> runs() const { return _runs; }
+    __forceinline const uint8_t* run_data(const region_run& run) const { return _data.data() + run.buffer_offset; }
+
     __forceinline uint64_t base() { return _header.base; }
 
     __forceinline size_t size() { return _header.size; }
 
-    __forceinline bool has_protection_flags(DWORD protect_flags) {
-		return (_mbi.Protect & protect_flags) != 0;
+    __forceinline bool has_protection_flags(uint32_t protect_flags) {
+		return (_info.protection & protect_flags) != 0;
     }
 
     __forceinline bool is_commited() {
-        return _mbi.State == MEM_COMMIT;
+        return _info.state == region_state::committed;
     }
 
 	__forceinline bool is_memmapped() {
-		return _mbi.Type == MEM_MAPPED;
+		return _info.kind == region_kind::mapped;
+	}
+
+	// Regions of loaded modules, their addresses are stable relative to the module.
+	__forceinline bool is_image() {
+		return _info.kind == region_kind::image;
+	}
+
+	// Anonymous memory of the process, pages it never touched read as zero.
+	__forceinline bool is_private() {
+		return _info.kind == region_kind::private_memory;
 	}
 };
 
@@ -90,8 +232,8 @@ inline DataType* memory_region::at_offset(size_t offset)
     if (offset + sizeof(DataType) > _header.size)
         return nullptr;
 
-    // Check if the memory region is valid.
-    if (!_valid)
+    // Check if the memory region is valid, sparse regions are only read through their runs.
+    if (!_valid || is_sparse() || _streamed)
         return nullptr;
 
     // If the region hasn't been discarded, use the primary data buffer.
@@ -99,7 +241,7 @@ inline DataType* memory_region::at_offset(size_t offset)
         return reinterpret_cast<DataType*>(_data.data() + offset);
 
     // If the region is discarded, try to map the chunk if needed.
-    if (!_mapped_info && !load())
+    if (_data_map.empty() && !load())
         return nullptr;
 
     return reinterpret_cast<DataType*>(_data_map.data() + offset);
@@ -128,25 +270,66 @@ inline DataType* memory_region::at_address(uint64_t address)
 }
 template<typename F>
 inline bool memory_region::read_data(F&& read_func, size_t& bytes_read) {
-    // Resize the vector to hold the required data.
-
-    _data.resize(_header.size);
+    auto request = prepare_read();
 
     // Call the provided functor to read memory.
     // Expected callable signature:
     //    bool(uint64_t address, void* buffer, size_t size, size_t* bytes_read)
-    if (read_func(_header.base, _data.data(), _header.size, &bytes_read)) {
-        if (_header.size != bytes_read) {
-            _data.resize(_header.size);
-        }
+    if (!read_func(request.address, request.buffer, request.size, &bytes_read))
+        bytes_read = 0;
+
+    request.bytes_read = bytes_read;
+    return complete_read(request);
+}
+
+inline read_request memory_region::prepare_read() {
+    // Pooled buffers are not zeroed, the read overwrites every byte kept.
+    _data.resize(_header.size);
+
+    return read_request{ _header.base, _data.data(), _header.size };
+}
+
+inline std::vector<read_request> memory_region::prepare_sparse_read(std::span<const std::pair<size_t, size_t>> runs) {
+    std::vector<read_request> requests;
+    size_t total = 0;
+
+    _runs.clear();
+
+    for (auto& [offset, size] : runs) {
+        _runs.push_back({ offset, size, total, false });
+        total += size;
+    }
+
+    _data.resize(total);
+
+    for (auto& run : _runs)
+        requests.push_back({ _header.base + run.offset, _data.data() + run.buffer_offset, run.size });
+
+    return requests;
+}
+
+inline bool memory_region::complete_sparse_read(std::span<const read_request> requests) {
+    _valid = false;
+
+    for (size_t i = 0; i < _runs.size(); i++) {
+        _runs[i].valid = requests[i].bytes_read == requests[i].size;
+        _valid = _valid || _runs[i].valid;
+    }
+
+    // Runs that failed are left in place so the others keep their buffer offsets.
+    _data_map = std::span<uint8_t>();
+    return _valid;
+}
 
-        _header.size = bytes_read;
+inline bool memory_region::complete_read(const read_request& request) {
+    if (request.bytes_read != 0 && request.bytes_read == request.size) {
+        _header.size = request.bytes_read;
         _valid = true;
         _data_map = std::span<uint8_t>(_data);
         return true;
     }
 
-    // If read fails, clear the vector.
+    // If read fails, hand the buffer back to the pool.
     _data.clear();
     _data.shrink_to_fit();
     _data_map = std::span<uint8_t>();  // Invalidate the span.
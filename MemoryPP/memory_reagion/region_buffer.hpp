@@ -0,0 +1,143 @@
+#pragma once
+#include "../platform.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// Uninitialized aligned blocks kept across scans. Rescans read the same regions again, their buffers
+// come back from the blocks of the regions dropped with the previous results instead of the allocator.
+class buffer_pool
+{
+public:
+    static constexpr size_t CACHE_LINE_BYTES = 64;
+    static constexpr size_t PAGE_BYTES = 4096;
+    static constexpr size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
+
+    struct block {
+        uint8_t* data{ nullptr };
+        size_t capacity{ 0 };
+    };
+
+private:
+    mutable std::mutex _mutex;
+    std::multimap<size_t, uint8_t*> _free;     // Cached blocks by capacity.
+    size_t _cached_bytes{ 0 };
+    size_t _max_cached_bytes{ size_t(1) << 30 };
+    bool _huge_pages{ false };
+
+    static size_t alignment(size_t capacity);
+    static void free_block(uint8_t* data, size_t capacity);
+
+public:
+    buffer_pool() = default;
+    ~buffer_pool();
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    // Process wide pool, used by every region. Never destroyed, regions may outlive static destruction.
+    static buffer_pool& shared() {
+        static auto pool = new buffer_pool();
+        return *pool;
+    }
+
+    // A block of at least size bytes, its content is left as the previous owner wrote it.
+    // Blocks of a page or more are page aligned, smaller ones cache line aligned.
+    block acquire(size_t size);
+
+    // Keeps blk for a later acquire, or frees it once the cache is full.
+    void recycle(block blk);
+
+    // Frees every cached block.
+    void trim();
+
+    __forceinline size_t cached_bytes() const { std::lock_guard<std::mutex> lock(_mutex); return _cached_bytes; }
+
+    __forceinline size_t max_cached_bytes() const { std::lock_guard<std::mutex> lock(_mutex); return _max_cached_bytes; }
+
+    // Blocks recycled beyond this are freed, 0 disables the cache.
+    __forceinline void set_max_cached_bytes(size_t bytes) { std::lock_guard<std::mutex> lock(_mutex); _max_cached_bytes = bytes; }
+
+    // Blocks of HUGE_PAGE_BYTES or more are aligned for and advised to use transparent huge pages. Linux only.
+    __forceinline void set_huge_pages(bool enabled) { _huge_pages = enabled; }
+};
+
+// Byte buffer of a region, a vector without the zero fill whose storage comes from and returns to a buffer_pool.
+class region_buffer
+{
+    buffer_pool::block _block;
+    size_t _size{ 0 };
+
+    __forceinline void release() {
+        if (_block.data)
+            buffer_pool::shared().recycle(std::exchange(_block, buffer_pool::block{}));
+        _size = 0;
+    }
+
+public:
+    region_buffer() = default;
+    ~region_buffer() { release(); }
+
+    region_buffer(const region_buffer&) = delete;
+    region_buffer& operator=(const region_buffer&) = delete;
+
+    region_buffer(region_buffer&& other) noexcept
+        : _block(std::exchange(other._block, buffer_pool::block{})), _size(std::exchange(other._size, 0)) {}
+
+    region_buffer& operator=(region_buffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            _block = std::exchange(other._block, buffer_pool::block{});
+            _size = std::exchange(other._size, 0);
+        }
+        return *this;
+    }
+
+    // Bytes past the previous size are left uninitialized.
+    void resize(size_t size) {
+        if (size > _block.capacity) {
+            auto grown = buffer_pool::shared().acquire(size);
+
+            if (_size)
+                std::memcpy(grown.data, _block.data, _size);
+
+            release();
+            _block = grown;
+        }
+        _size = size;
+    }
+
+    void assign(const uint8_t* first, const uint8_t* last) {
+        _size = 0;
+        resize(static_cast<size_t>(last - first));
+
+        if (_size)
+            std::memcpy(_block.data, first, _size);
+    }
+
+    __forceinline void clear() { _size = 0; }
+
+    // Hands the storage back to the pool once the buffer is empty.
+    __forceinline void shrink_to_fit() {
+        if (_size == 0)
+            release();
+    }
+
+    __forceinline uint8_t* data() { return _block.data; }
+    __forceinline const uint8_t* data() const { return _block.data; }
+    __forceinline size_t size() const { return _size; }
+    __forceinline size_t capacity() const { return _block.capacity; }
+    __forceinline bool empty() const { return _size == 0; }
+
+    __forceinline uint8_t* begin() { return _block.data; }
+    __forceinline uint8_t* end() { return _block.data + _size; }
+    __forceinline const uint8_t* begin() const { return _block.data; }
+    __forceinline const uint8_t* end() const { return _block.data + _size; }
+
+    __forceinline uint8_t& operator[](size_t index) { return _block.data[index]; }
+    __forceinline const uint8_t& operator[](size_t index) const { return _block.data[index]; }
+};
@@ -0,0 +1,29 @@
+#pragma once
+#include "memory_region.hpp"
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// The regions of a scan sorted by base, looked up by address range.
+// Regions never overlap, so those intersecting a range are a contiguous slice found by binary search.
+class region_index
+{
+    struct bounds {
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    std::vector<std::shared_ptr<memory_region>> _regions;
+    std::vector<bounds> _bounds;    // Kept apart from the regions, lookups only touch this.
+
+public:
+    // Takes every region of the queue.
+    explicit region_index(std::queue<std::shared_ptr<memory_region>>& regions);
+
+    // Positions [first, last) of the regions intersecting [begin, end).
+    std::pair<size_t, size_t> overlapping(uint64_t begin, uint64_t end) const;
+
+    __forceinline size_t size() const { return _regions.size(); }
+    __forceinline const std::shared_ptr<memory_region>& operator[](size_t position) const { return _regions[position]; }
+};
@@ -1 +1,294 @@
 #include "../memory_region.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t PRIME_3 = 0x165667B19E3779F9ull;
+
+__forceinline uint64_t load64(const uint8_t* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+__forceinline uint64_t hash_round(uint64_t acc, uint64_t value) {
+    return std::rotl(acc + value * PRIME_2, 31) * PRIME_1;
+}
+
+// xxh64 style hash, four independent lanes over 32 byte stripes.
+uint64_t hash_bytes(const uint8_t* data, size_t size) {
+    uint64_t lanes[4] = { PRIME_1 + PRIME_2, PRIME_2, 0, 0 - PRIME_1 };
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        for (size_t lane = 0; lane < 4; lane++)
+            lanes[lane] = hash_round(lanes[lane], load64(data + i + lane * 8));
+    }
+
+    uint64_t hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+    hash += size;
+
+    for (; i < size; i++)
+        hash = std::rotl(hash ^ (data[i] * PRIME_3), 11) * PRIME_1;
+
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+
+    // 0 marks the pages that were not hashed.
+    return hash ? hash : 1;
+}
+
+}
+
+bool memory_region::dump_compressed()
+{
+    if (_data.empty())
+        return false;
+
+    size_t size = _data.size();
+    size_t pages = (size + PAGE_BYTES - 1) / PAGE_BYTES;
+    uint32_t stored = 0;
+
+    _pages.resize(pages);
+
+    for (size_t page = 0; page < pages; page++) {
+        size_t begin = page * PAGE_BYTES;
+        size_t count = std::min(PAGE_BYTES, size - begin);
+        uint8_t* bytes = _data.data() + begin;
+
+        // A page equal to itself shifted by one byte holds a single value.
+        if (std::memcmp(bytes, bytes + 1, count - 1) == 0) {
+            _pages[page] = { snapshot_page::FILLED, bytes[0] };
+            continue;
+        }
+
+        // Stored pages are packed at the front of the buffer, they only ever move down.
+        if (stored != page)
+            std::memmove(_data.data() + stored * PAGE_BYTES, bytes, count);
+
+        _pages[page] = { stored++, 0 };
+        _stored_bytes = stored * PAGE_BYTES - (PAGE_BYTES - count);
+    }
+
+    // Nothing to elide, the plain dump maps back without decoding.
+    if (stored == pages) {
+        _pages.clear();
+        _stored_bytes = 0;
+        return dump(true);
+    }
+
+    _data.resize(_stored_bytes);
+
+    if (_data.empty()) {
+        _data.shrink_to_fit();
+        _data_map = std::span<uint8_t>();
+        _mapped_info.reset();
+        _discarded = true;
+        return true;
+    }
+
+    return dump(true);
+}
+
+bool memory_region::read_snapshot(size_t offset, size_t size, uint8_t* out)
+{
+    if (offset + size > _header.size || !_valid)
+        return false;
+
+    if (!is_compressed() || !_data_map.empty()) {
+        auto bytes = view();
+
+        if (bytes.size() < offset + size)
+            return false;
+
+        std::memcpy(out, bytes.data() + offset, size);
+        return true;
+    }
+
+    if (_stored_bytes && !_mapped_info) {
+        _mapped_info = _file.read(_file_offset.value(), _stored_bytes);
+
+        if (!_mapped_info)
+            return false;
+    }
+
+    auto stored = _mapped_info ? static_cast<const uint8_t*>(_mapped_info->pointer) : nullptr;
+
+    while (size) {
+        size_t in_page = offset % PAGE_BYTES;
+        size_t count = std::min(size, PAGE_BYTES - in_page);
+        auto& page = _pages[offset / PAGE_BYTES];
+
+        if (page.stored == snapshot_page::FILLED)
+            std::memset(out, page.fill, count);
+        else
+            std::memcpy(out, stored + page.stored * PAGE_BYTES + in_page, count);
+
+        out += count;
+        offset += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+bool memory_region::load()
+{
+    if (!is_compressed())
+        return dumpable<region_header, uint8_t, region_buffer>::load();
+
+    if (!_data_map.empty())
+        return true;
+
+    region_buffer plain;
+    plain.resize(_header.size);
+
+    if (!read_snapshot(0, plain.size(), plain.data()))
+        return false;
+
+    _data = std::move(plain);
+    _data_map = std::span<uint8_t>(_data);
+    return true;
+}
+
+bool memory_region::map_snapshot()
+{
+    if (!_valid || !_discarded || is_sparse())
+        return _valid;
+
+    if (!is_compressed())
+        return dumpable<region_header, uint8_t, region_buffer>::load();
+
+    if (_stored_bytes && !_mapped_info)
+        _mapped_info = _file.read(_file_offset.value(), _stored_bytes);
+
+    return !_stored_bytes || _mapped_info;
+}
+
+std::span<uint8_t> memory_region::view()
+{
+    if (is_sparse())
+        return std::span<uint8_t>();
+
+    if (!is_compressed())
+        return dumpable<region_header, uint8_t, region_buffer>::view();
+
+    if (!_valid || !load())
+        return std::span<uint8_t>();
+
+    return _data_map;
+}
+
+void memory_region::hash_pages()
+{
+    _page_hashes.resize((_header.size + PAGE_BYTES - 1) / PAGE_BYTES, 0);
+
+    if (!_valid)
+        return;
+
+    if (is_sparse()) {
+        // Runs are cut on page boundaries.
+        for (auto& run : _runs) {
+            if (run.valid)
+                hash_range(run_data(run), run.offset, run.size);
+        }
+        return;
+    }
+
+    auto bytes = view();
+    hash_range(bytes.data(), 0, bytes.size());
+}
+
+void memory_region::hash_range(const uint8_t* data, size_t offset, size_t size)
+{
+    static const uint64_t zero_page_hash = []() {
+        std::vector<uint8_t> zeros(PAGE_BYTES, 0);
+        return hash_bytes(zeros.data(), zeros.size());
+    }();
+
+    for (size_t begin = 0; begin < size; begin += PAGE_BYTES) {
+        size_t page = (offset + begin) / PAGE_BYTES;
+        size_t bytes = std::min(PAGE_BYTES, size - begin);
+
+        if (page >= _page_hashes.size() || _page_hashes[page])
+            continue;
+
+        // Pages the read skipped are known to be zero.
+        if (bytes == PAGE_BYTES && !page_populated(page))
+            _page_hashes[page] = zero_page_hash;
+        else
+            _page_hashes[page] = hash_bytes(data + begin, bytes);
+    }
+}
+
+void memory_region::begin_stream()
+{
+    _data.clear();
+    _data.shrink_to_fit();
+    _data_map = std::span<uint8_t>();
+    _runs.clear();
+    _page_hashes.assign((_header.size + PAGE_BYTES - 1) / PAGE_BYTES, 0);
+    _streamed = true;
+    _valid = true;
+}
+
+void memory_region::reuse(const region_info& info)
+{
+    _info = info;
+    _header.base = info.base;
+    _header.size = info.size;
+    _file_offset = 0;
+
+    _data.clear();
+    _data_map = std::span<uint8_t>();
+    _mapped_info.reset();
+    _valid = false;
+    _discarded = false;
+
+    _runs.clear();
+    _page_hashes.clear();
+    _written_pages.clear();
+    _populated_pages.clear();
+    _streamed = false;
+    _pages.clear();
+    _stored_bytes = 0;
+}
+
+void memory_region::release_buffer()
+{
+    _data.clear();
+    _data.shrink_to_fit();
+    _data_map = std::span<uint8_t>();
+    _runs.clear();
+    _valid = false;
+}
+
+void memory_region::set_page_hash(size_t page, uint64_t hash)
+{
+    _page_hashes.resize((_header.size + PAGE_BYTES - 1) / PAGE_BYTES, 0);
+
+    if (page < _page_hashes.size())
+        _page_hashes[page] = hash;
+}
+
+bool memory_region::same_page(const memory_region& lhs, const memory_region& rhs, uint64_t address)
+{
+    if (address < lhs._header.base || address < rhs._header.base)
+        return false;
+
+    uint64_t lhs_offset = address - lhs._header.base;
+    uint64_t rhs_offset = address - rhs._header.base;
+
+    // Pages only line up between regions starting on the same page boundary.
+    if (lhs_offset % PAGE_BYTES != rhs_offset % PAGE_BYTES)
+        return false;
+
+    uint64_t hash = lhs.page_hash(lhs_offset / PAGE_BYTES);
+    return hash != 0 && hash == rhs.page_hash(rhs_offset / PAGE_BYTES);
+}
@@ -0,0 +1,89 @@
+#include "../region_buffer.hpp"
+#include <new>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+buffer_pool::~buffer_pool()
+{
+    trim();
+}
+
+size_t buffer_pool::alignment(size_t capacity)
+{
+    if (capacity >= HUGE_PAGE_BYTES)
+        return HUGE_PAGE_BYTES;
+
+    return capacity >= PAGE_BYTES ? PAGE_BYTES : CACHE_LINE_BYTES;
+}
+
+void buffer_pool::free_block(uint8_t* data, size_t capacity)
+{
+    ::operator delete(data, std::align_val_t(alignment(capacity)));
+}
+
+buffer_pool::block buffer_pool::acquire(size_t size)
+{
+    if (size == 0)
+        return {};
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // Regions are read again at the same size, the closest block is usually an exact fit.
+        // Blocks more than twice as big are left for bigger regions.
+        auto it = _free.lower_bound(size);
+
+        if (it != _free.end() && it->first / 2 <= size) {
+            block reused{ it->second, it->first };
+            _cached_bytes -= it->first;
+            _free.erase(it);
+            return reused;
+        }
+    }
+
+    // Blocks are aligned for their capacity, the one free_block is given back. Rounding the size up may reach
+    // the next alignment threshold, which is a multiple of the smaller alignment.
+    size_t capacity = (size + alignment(size) - 1) / alignment(size) * alignment(size);
+    size_t align = alignment(capacity);
+    auto data = static_cast<uint8_t*>(::operator new(capacity, std::align_val_t(align)));
+
+#ifndef _WIN32
+    if (_huge_pages && capacity >= HUGE_PAGE_BYTES)
+        madvise(data, capacity, MADV_HUGEPAGE);
+#endif
+
+    return { data, capacity };
+}
+
+void buffer_pool::recycle(block blk)
+{
+    if (!blk.data)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_cached_bytes + blk.capacity <= _max_cached_bytes) {
+            _free.emplace(blk.capacity, blk.data);
+            _cached_bytes += blk.capacity;
+            return;
+        }
+    }
+
+    free_block(blk.data, blk.capacity);
+}
+
+void buffer_pool::trim()
+{
+    std::multimap<size_t, uint8_t*> cached;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        cached.swap(_free);
+        _cached_bytes = 0;
+    }
+
+    for (auto& [capacity, data] : cached)
+        free_block(data, capacity);
+}
@@ -0,0 +1,31 @@
+#include "../region_index.hpp"
+#include <algorithm>
+
+region_index::region_index(std::queue<std::shared_ptr<memory_region>>& regions)
+{
+    _regions.reserve(regions.size());
+
+    while (!regions.empty()) {
+        _regions.push_back(std::move(regions.front()));
+        regions.pop();
+    }
+
+    // Hosts enumerate regions in address order, sorting only guards against those that don't.
+    std::stable_sort(_regions.begin(), _regions.end(), [](const std::shared_ptr<memory_region>& lhs, const std::shared_ptr<memory_region>& rhs) {
+        return lhs->base() < rhs->base();
+    });
+
+    _bounds.reserve(_regions.size());
+
+    for (auto& region : _regions)
+        _bounds.push_back({ region->base(), region->base() + region->size() });
+}
+
+std::pair<size_t, size_t> region_index::overlapping(uint64_t begin, uint64_t end) const
+{
+    // Both the begins and the ends are sorted since regions don't overlap.
+    auto first = std::partition_point(_bounds.begin(), _bounds.end(), [&](const bounds& region) { return region.end <= begin; });
+    auto last = std::partition_point(first, _bounds.end(), [&](const bounds& region) { return region.begin < end; });
+
+    return { static_cast<size_t>(first - _bounds.begin()), static_cast<size_t>(last - _bounds.begin()) };
+}
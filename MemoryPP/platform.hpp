@@ -0,0 +1,14 @@
+#pragma once
+
+// Host specific includes and the few MSVC keywords the code base relies on.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/types.h>
+
+#ifndef __forceinline
+#define __forceinline inline __attribute__((always_inline))
+#endif
+#endif
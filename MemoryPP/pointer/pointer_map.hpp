@@ -0,0 +1,80 @@
+#pragma once
+#include "../file_dump/dumpable.hpp"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+struct pointer_entry {
+    uint64_t address;   // Where the pointer is stored.
+    uint64_t value;     // Where it points.
+};
+
+// The regions and modules are saved right after the entries.
+struct pointer_map_header {
+    uint64_t size;
+    uint64_t region_count;
+    uint64_t regions_offset;
+    uint64_t module_count;
+    uint64_t modules_offset;
+};
+
+// A region pointers may point into. Image regions hold the static addresses chains start from.
+struct pointer_region {
+    uint64_t base;
+    uint64_t size;
+    bool is_static;
+};
+
+// A module static addresses are taken relative to, saved with a fixed size name.
+struct pointer_module {
+    static constexpr size_t NAME_BYTES = 256;
+
+    uint64_t base;
+    uint64_t size;
+    char name[NAME_BYTES];  // Null terminated, longer names are cut.
+};
+
+// Every aligned 64-bit value of a process that points into one of its regions, sorted by value.
+// The entries, regions and modules are saved to the file_dump once assigned and mapped back when
+// they are looked up, so the map survives between pointer scans without being rebuilt.
+class pointer_map : public dumpable<pointer_map_header, pointer_entry>
+{
+    std::span<const pointer_region> _regions;   // Sorted by base.
+    std::span<const pointer_module> _modules;   // Sorted by base.
+    std::unique_ptr<mapped_chunk> _regions_chunk;
+    std::unique_ptr<mapped_chunk> _modules_chunk;
+
+    template<typename T>
+    bool map_table(uint64_t offset, uint64_t count, std::unique_ptr<mapped_chunk>& chunk, std::span<const T>& table);
+
+public:
+    explicit pointer_map(file_dump& file) : dumpable<pointer_map_header, pointer_entry>(file) {}
+
+    // Sorts the entries by value and saves them with the regions and modules, both sorted by base.
+    bool assign(std::vector<pointer_region> regions, std::vector<pointer_module> modules, std::vector<pointer_entry> entries);
+
+    // Maps the entries, regions and modules back from the file. The lookups below only read them
+    // afterwards, it must run before the map is shared between threads.
+    bool map_back();
+
+    // The region of a list sorted by base holding address, or null.
+    static const pointer_region* find_region(std::span<const pointer_region> regions, uint64_t address);
+
+    __forceinline const pointer_region* find_region(uint64_t address) const { return find_region(_regions, address); }
+
+    __forceinline bool is_static(uint64_t address) const {
+        auto region = find_region(address);
+        return region && region->is_static;
+    }
+
+    // The module holding address, or null.
+    const pointer_module* find_module(uint64_t address) const;
+
+    // Entries whose value lies in [low, high], in value order.
+    std::span<pointer_entry> pointing_to(uint64_t low, uint64_t high);
+
+    __forceinline size_t size() const { return this->_valid ? this->_header.size : 0; }
+    __forceinline std::span<const pointer_region> regions() const { return _regions; }
+    __forceinline std::span<const pointer_module> modules() const { return _modules; }
+};
@@ -0,0 +1,134 @@
+#include "../pointer_map.hpp"
+#include <algorithm>
+
+namespace {
+
+// Writes a table to the file, an empty one takes no space.
+template<typename T>
+std::optional<uint64_t> save_table(file_dump& file, const std::vector<T>& table)
+{
+    if (table.empty())
+        return 0;
+
+    return file.write(reinterpret_cast<const uint8_t*>(table.data()), table.size() * sizeof(T));
+}
+
+}
+
+bool pointer_map::assign(std::vector<pointer_region> regions, std::vector<pointer_module> modules, std::vector<pointer_entry> entries)
+{
+    std::sort(entries.begin(), entries.end(), [](const pointer_entry& lhs, const pointer_entry& rhs) {
+        return lhs.value != rhs.value ? lhs.value < rhs.value : lhs.address < rhs.address;
+    });
+
+    _regions = {};
+    _modules = {};
+    _regions_chunk.reset();
+    _modules_chunk.reset();
+
+    this->_header = {};
+    this->_data = std::move(entries);
+    this->_header.size = this->_data.size();
+    this->_data_map = std::span<pointer_entry>(this->_data);
+    this->_mapped_info.reset();
+    this->_discarded = false;
+    this->_valid = true;
+
+    // An empty map has nothing to save, no chain can be looked up in it.
+    if (this->_data.empty())
+        return true;
+
+    auto regions_offset = save_table(this->_file, regions);
+    auto modules_offset = save_table(this->_file, modules);
+
+    if (!regions_offset || !modules_offset) {
+        this->_valid = false;
+        return false;
+    }
+
+    this->_header.region_count = regions.size();
+    this->_header.regions_offset = *regions_offset;
+    this->_header.module_count = modules.size();
+    this->_header.modules_offset = *modules_offset;
+
+    return this->dump(true);
+}
+
+template<typename T>
+bool pointer_map::map_table(uint64_t offset, uint64_t count, std::unique_ptr<mapped_chunk>& chunk, std::span<const T>& table)
+{
+    if (count == 0 || !table.empty())
+        return true;
+
+    chunk = this->_file.read(offset, count * sizeof(T));
+
+    if (!chunk)
+        return false;
+
+    table = std::span<const T>(reinterpret_cast<const T*>(chunk->pointer), count);
+    return true;
+}
+
+bool pointer_map::map_back()
+{
+    if (!this->_valid)
+        return false;
+
+    if (this->_header.size == 0)
+        return true;
+
+    if (this->view().empty())
+        return false;
+
+    return map_table(this->_header.regions_offset, this->_header.region_count, _regions_chunk, _regions)
+        && map_table(this->_header.modules_offset, this->_header.module_count, _modules_chunk, _modules);
+}
+
+const pointer_region* pointer_map::find_region(std::span<const pointer_region> regions, uint64_t address)
+{
+    auto next = std::upper_bound(regions.begin(), regions.end(), address, [](uint64_t value, const pointer_region& region) {
+        return value < region.base;
+    });
+
+    if (next == regions.begin())
+        return nullptr;
+
+    auto region = std::prev(next);
+
+    if (address - region->base >= region->size)
+        return nullptr;
+
+    return &*region;
+}
+
+const pointer_module* pointer_map::find_module(uint64_t address) const
+{
+    auto next = std::upper_bound(_modules.begin(), _modules.end(), address, [](uint64_t value, const pointer_module& image) {
+        return value < image.base;
+    });
+
+    if (next == _modules.begin())
+        return nullptr;
+
+    auto image = std::prev(next);
+
+    if (address - image->base >= image->size)
+        return nullptr;
+
+    return &*image;
+}
+
+std::span<pointer_entry> pointer_map::pointing_to(uint64_t low, uint64_t high)
+{
+    auto entries = this->view();
+
+    auto first = std::lower_bound(entries.begin(), entries.end(), low, [](const pointer_entry& entry, uint64_t value) {
+        return entry.value < value;
+    });
+
+    auto last = std::upper_bound(first, entries.end(), high, [](uint64_t value, const pointer_entry& entry) {
+        return value < entry.value;
+    });
+
+    return std::span<pointer_entry>(first, last);
+}
@@ -0,0 +1,238 @@
+#include "pointer_scanner.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+std::optional<uint64_t> resolve_start(const pointer_chain& chain, std::span<const module_info> modules)
+{
+    if (chain.module.empty())
+        return chain.module_offset;
+
+    for (auto& loaded : modules) {
+        if (loaded.name == chain.module)
+            return loaded.base + chain.module_offset;
+    }
+
+    return std::nullopt;
+}
+
+}
+
+size_t pointer_scanner::build_map(const std::pair<void*, void*>& range)
+{
+    auto regions = get_regions(range, protection_read);
+
+    std::vector<pointer_region> targets;
+    auto pending = regions;
+
+    while (!pending.empty()) {
+        auto& region = pending.front();
+        targets.push_back({ region->base(), region->size(), region->is_image() });
+        pending.pop();
+    }
+
+    if (targets.empty()) {
+        _map.assign({}, {}, {});
+        return 0;
+    }
+
+    // Static addresses are saved relative to these, the chains found later must not depend on where they were loaded.
+    std::vector<pointer_module> modules;
+
+    for (auto& loaded : _access->query_modules()) {
+        pointer_module saved{ loaded.base, loaded.size, {} };
+        std::memcpy(saved.name, loaded.name.data(), std::min(loaded.name.size(), pointer_module::NAME_BYTES - 1));
+        modules.push_back(saved);
+    }
+
+    uint64_t lowest = targets.front().base;
+    uint64_t highest = targets.back().base + targets.back().size;
+
+    // Regions are page aligned and slices are cut at multiples of the pointer size, every slice starts aligned.
+    auto entries = search_regions<pointer_entry>(regions, 0,
+        [&](const uint8_t* data, size_t size, uint64_t base, std::vector<pointer_entry>& out) {
+            for (size_t offset = 0; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+                uint64_t value;
+                std::memcpy(&value, data + offset, sizeof(value));
+
+                // Most values are rejected by the bounds before the lookup.
+                if (value < lowest || value >= highest)
+                    continue;
+
+                if (pointer_map::find_region(targets, value))
+                    out.push_back({ base + offset, value });
+            }
+        });
+
+    if (!_map.assign(std::move(targets), std::move(modules), std::move(entries)))
+        return 0;
+
+    return _map.size();
+}
+
+pointer_chain pointer_scanner::make_chain(uint64_t address, const std::vector<uint64_t>& offsets) const
+{
+    auto image = _map.find_module(address);
+    std::vector<uint64_t> forward(offsets.rbegin(), offsets.rend());
+
+    if (!image)
+        return { std::string(), address, std::move(forward) };
+
+    return { std::string(image->name, strnlen(image->name, pointer_module::NAME_BYTES)), address - image->base, std::move(forward) };
+}
+
+void pointer_scanner::find_chains(uint64_t target, size_t level, size_t max_level, uint64_t max_offset, size_t max_results,
+    std::vector<uint64_t>& offsets, std::unordered_map<uint64_t, size_t>& visited, std::atomic<size_t>& found,
+    std::vector<pointer_chain>& out)
+{
+    auto candidates = _map.pointing_to(target >= max_offset ? target - max_offset : 0, target);
+
+    // Closest pointers first, they give the smallest offsets.
+    for (size_t i = candidates.size(); i-- > 0;) {
+        if (found >= max_results)
+            return;
+
+        auto& entry = candidates[i];
+        offsets.push_back(target - entry.value);
+
+        if (_map.is_static(entry.address)) {
+            out.push_back(make_chain(entry.address, offsets));
+            found++;
+        }
+
+        // An address followed before at this level or a shallower one only leads to the starts found then,
+        // and a cycle of pointers would be walked around until max_level.
+        if (level + 1 < max_level) {
+            auto [visit, inserted] = visited.try_emplace(entry.address, level + 1);
+
+            if (inserted || visit->second > level + 1) {
+                visit->second = level + 1;
+                find_chains(entry.address, level + 1, max_level, max_offset, max_results, offsets, visited, found, out);
+            }
+        }
+
+        offsets.pop_back();
+    }
+}
+
+std::vector<pointer_chain> pointer_scanner::find_chains(uint64_t target, size_t max_level, uint64_t max_offset, size_t max_results)
+{
+    std::vector<pointer_chain> chains;
+
+    if (max_level == 0 || _map.size() == 0)
+        return chains;
+
+    // Map the tables back once, the searches below only read them.
+    if (!_map.map_back())
+        return chains;
+
+    auto first_level = _map.pointing_to(target >= max_offset ? target - max_offset : 0, target);
+
+    // Every pointer to the target roots an independent search.
+    std::vector<std::vector<pointer_chain>> parts(first_level.size());
+    std::atomic<size_t> found = 0;
+
+    {
+        task_group group(*_pool);
+
+        for (size_t i = 0; i < first_level.size(); i++) {
+            group.run([&, i]() {
+                auto& entry = first_level[first_level.size() - 1 - i];
+                std::vector<uint64_t> offsets{ target - entry.value };
+                std::unordered_map<uint64_t, size_t> visited{ { target, 0 }, { entry.address, 1 } };
+
+                if (found >= max_results)
+                    return;
+
+                if (_map.is_static(entry.address)) {
+                    parts[i].push_back(make_chain(entry.address, offsets));
+                    found++;
+                }
+
+                if (max_level > 1)
+                    find_chains(entry.address, 1, max_level, max_offset, max_results, offsets, visited, found, parts[i]);
+            });
+        }
+
+        group.wait();
+    }
+
+    for (auto& part : parts)
+        chains.insert(chains.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+
+    if (chains.size() > max_results)
+        chains.resize(max_results);
+
+    return chains;
+}
+
+std::optional<uint64_t> pointer_scanner::resolve(const pointer_chain& chain)
+{
+    if (!_access)
+        return std::nullopt;
+
+    return resolve_start(chain, _access->query_modules());
+}
+
+std::vector<pointer_chain> pointer_scanner::filter_chains(std::span<const pointer_chain> chains, uint64_t target)
+{
+    std::vector<pointer_chain> kept;
+
+    if (!_access)
+        return kept;
+
+    // Current address of every chain, all the chains are advanced one dereference per batched read.
+    // Chains whose module is not loaded are dropped.
+    auto modules = _access->query_modules();
+    std::vector<uint64_t> addresses(chains.size());
+    std::vector<size_t> active;
+
+    for (size_t i = 0; i < chains.size(); i++) {
+        auto start = resolve_start(chains[i], modules);
+
+        if (!start || chains[i].offsets.empty())
+            continue;
+
+        addresses[i] = *start;
+        active.push_back(i);
+    }
+
+    std::vector<uint64_t> values;
+    std::vector<read_request> requests;
+
+    for (size_t level = 0; !active.empty(); level++) {
+        values.assign(active.size(), 0);
+        requests.resize(active.size());
+
+        for (size_t k = 0; k < active.size(); k++)
+            requests[k] = { addresses[active[k]], &values[k], sizeof(uint64_t) };
+
+        _access->read_batch(requests);
+
+        size_t next = 0;
+
+        for (size_t k = 0; k < active.size(); k++) {
+            size_t i = active[k];
+
+            if (requests[k].bytes_read != sizeof(uint64_t))
+                continue;
+
+            addresses[i] = values[k] + chains[i].offsets[level];
+
+            if (level + 1 == chains[i].offsets.size()) {
+                if (addresses[i] == target)
+                    kept.push_back(chains[i]);
+                continue;
+            }
+
+            active[next++] = i;
+        }
+
+        active.resize(next);
+    }
+
+    return kept;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "scan_engine.hpp"
+#include "pointer/pointer_map.hpp"
+
+// The start is kept relative to its module so the chain still holds after a restart moved the module.
+struct pointer_chain {
+    std::string module;             // Module the chain starts in, empty when no module holds the start.
+    uint64_t module_offset;         // Start relative to the module base, the start address itself without a module.
+    std::vector<uint64_t> offsets;  // Added after each dereference, the last one lands on the target.
+};
+
+// Finds pointer paths from static addresses to a target. A single parallel pass builds the pointer map,
+// which is kept in its own file so any number of targets can be resolved against it.
+class pointer_scanner : public scan_engine
+{
+    file_dump _map_file;
+    pointer_map _map;
+
+    // visited holds the lowest level each address was followed at by the current search.
+    void find_chains(uint64_t target, size_t level, size_t max_level, uint64_t max_offset, size_t max_results,
+        std::vector<uint64_t>& offsets, std::unordered_map<uint64_t, size_t>& visited, std::atomic<size_t>& found,
+        std::vector<pointer_chain>& out);
+
+    // A chain starting at the static address, offsets collected from the target backwards.
+    pointer_chain make_chain(uint64_t address, const std::vector<uint64_t>& offsets) const;
+
+public:
+    pointer_scanner(long process_id, const std::string& map_file = "pointer_map.bin", std::shared_ptr<thread_pool> pool = nullptr)
+        : scan_engine(process_id, std::move(pool)), _map_file(map_file), _map(_map_file) {}
+    pointer_scanner(std::shared_ptr<process_access> access, const std::string& map_file = "pointer_map.bin", std::shared_ptr<thread_pool> pool = nullptr)
+        : scan_engine(std::move(access), std::move(pool)), _map_file(map_file), _map(_map_file) {}
+    virtual ~pointer_scanner() override = default;
+
+    // Collects the pointers stored in the readable regions of range, replacing the previous map.
+    // Returns the number of pointers found.
+    size_t build_map(const std::pair<void*, void*>& range);
+
+    // Chains of at most max_level dereferences ending on target, each offset at most max_offset.
+    // Stops once max_results chains are found.
+    std::vector<pointer_chain> find_chains(uint64_t target, size_t max_level, uint64_t max_offset, size_t max_results = SIZE_MAX);
+
+    // Start address of a chain in the live process, its module is looked up by name.
+    // Empty when the module is not loaded.
+    std::optional<uint64_t> resolve(const pointer_chain& chain);
+
+    // Keeps the chains that still lead to target in the live process.
+    std::vector<pointer_chain> filter_chains(std::span<const pointer_chain> chains, uint64_t target);
+
+    __forceinline pointer_map& get_map() { return _map; }
+};
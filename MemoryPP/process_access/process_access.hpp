@@ -0,0 +1,102 @@
+#pragma once
+#include "../platform.hpp"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// Protection bits of a region, translated from the host representation.
+enum region_protection : uint32_t {
+    protection_none          = 0,
+    protection_read          = 1 << 0,
+    protection_write         = 1 << 1,
+    protection_execute       = 1 << 2,
+    protection_copy_on_write = 1 << 3,
+};
+
+enum class region_state : uint8_t {
+    committed,
+    reserved,
+    free
+};
+
+enum class region_kind : uint8_t {
+    private_memory,
+    image,
+    mapped
+};
+
+struct region_info {
+    uint64_t base{ 0 };
+    size_t size{ 0 };
+    uint32_t protection{ protection_none };
+    region_state state{ region_state::free };
+    region_kind kind{ region_kind::private_memory };
+};
+
+// An executable or library loaded in the process. Its base changes between runs, addresses that must
+// survive a restart are kept relative to it.
+struct module_info {
+    std::string name;   // File name, without the directory.
+    uint64_t base{ 0 };
+    size_t size{ 0 };
+};
+
+// A single entry of a batched read.
+struct read_request {
+    uint64_t address{ 0 };
+    void* buffer{ nullptr };
+    size_t size{ 0 };
+    size_t bytes_read{ 0 };
+};
+
+// Access to the address space of a target process.
+// Each host provides one implementation, created through open().
+class process_access {
+public:
+    virtual ~process_access() = default;
+
+    // Enumerates the regions intersecting [start, end), clipped to the range.
+    virtual std::vector<region_info> query_regions(uint64_t start, uint64_t end) = 0;
+
+    // Enumerates the loaded modules, sorted by base.
+    virtual std::vector<module_info> query_modules() = 0;
+
+    // Reads size bytes at address. Returns true only if the whole range was read.
+    virtual bool read(uint64_t address, void* buffer, size_t size, size_t* bytes_read) = 0;
+
+    // Reads every request, filling bytes_read for each one.
+    // Returns the number of requests that were read completely.
+    // Implementations should override this when the host can read many ranges with one call.
+    virtual size_t read_batch(std::span<read_request> requests) {
+        size_t completed = 0;
+
+        for (auto& request : requests) {
+            request.bytes_read = 0;
+            if (read(request.address, request.buffer, request.size, &request.bytes_read))
+                completed++;
+        }
+        return completed;
+    }
+
+    // Write tracking, for hosts that can tell which pages a process wrote since a given point.
+    // Pages are TRACKING_PAGE_BYTES long, written holds one bit per page of [address, address + size).
+    static constexpr size_t TRACKING_PAGE_BYTES = 4096;
+
+    // Starts a new tracking period for the whole process. Returns false when the host can't track writes.
+    virtual bool reset_written_pages() { return false; }
+
+    // Sets the bits of the pages written since the last reset. Returns false when that is unknown,
+    // every page must then be assumed written.
+    virtual bool query_written_pages(uint64_t /*address*/, size_t /*size*/, std::vector<uint64_t>& /*written*/) { return false; }
+
+    // Sets the bits of the pages backed by memory, resident or swapped out, laid out as above.
+    // Pages of private anonymous regions left unset were never touched and read as zero.
+    // Returns false when the host can't tell.
+    virtual bool query_populated_pages(uint64_t /*address*/, size_t /*size*/, std::vector<uint64_t>& /*populated*/) { return false; }
+
+    // Creates the backend for the current host.
+    // On Windows process_id is the value of an opened process HANDLE, on Linux it is the pid.
+    static std::unique_ptr<process_access> open(long process_id);
+};
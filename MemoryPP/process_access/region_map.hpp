@@ -0,0 +1,32 @@
+#pragma once
+#include "process_access.hpp"
+#include <span>
+#include <utility>
+#include <vector>
+
+// Differences between two enumerations of the same range. Regions are told apart by base,
+// a region keeping its base with other bounds or attributes is changed.
+struct region_changes {
+    std::vector<region_info> added;
+    std::vector<region_info> removed;
+    std::vector<region_info> changed;   // As they are now.
+    std::vector<std::pair<size_t, size_t>> unchanged;  // Positions in the previous and in the new enumeration.
+};
+
+// The regions of a range as last enumerated, kept between scans to tell what the target mapped,
+// unmapped or reprotected in the meantime.
+class region_map
+{
+    uint64_t _start{ 0 };
+    uint64_t _end{ 0 };
+    std::vector<region_info> _regions;     // Sorted by base.
+    region_changes _changes;
+
+public:
+    // Replaces the regions with a new enumeration of [start, end), sorted by base, and diffs them against the
+    // previous one. Every region is added when the range differs from the previous enumeration.
+    const region_changes& update(uint64_t start, uint64_t end, std::vector<region_info> regions);
+
+    __forceinline const region_changes& changes() const { return _changes; }
+    __forceinline std::span<const region_info> regions() const { return _regions; }
+};
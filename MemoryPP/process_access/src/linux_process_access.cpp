@@ -0,0 +1,472 @@
+#ifdef __linux__
+#include "../process_access.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+class linux_process_access : public process_access {
+    pid_t _pid;
+    int _mem_fd{ -1 };
+    std::once_flag _mem_fd_once;
+    std::atomic<bool> _use_mem_file{ false };
+    int _pagemap_fd{ -1 };
+    std::once_flag _pagemap_fd_once;
+
+    // Upper bound of iovec entries accepted by a single process_vm_readv call.
+    static constexpr size_t MAX_IOVECS = IOV_MAX;
+
+    // Takes the number at the front of text along with the separator that follows it.
+    static bool take_number(std::string_view& text, uint64_t& value, int base) {
+        auto [next, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+
+        if (error != std::errc() || next == text.data())
+            return false;
+
+        text.remove_prefix(std::min(text.size(), static_cast<size_t>(next - text.data()) + 1));
+        return true;
+    }
+
+    static std::string_view take_field(std::string_view& text) {
+        auto space = text.find(' ');
+        auto field = text.substr(0, space);
+
+        text.remove_prefix(space == std::string_view::npos ? text.size() : space + 1);
+        return field;
+    }
+
+    // start-end perms offset dev inode [path], the path may be missing or hold spaces.
+    static bool parse_line(std::string_view line, region_info& info, std::string_view* path = nullptr) {
+        uint64_t start = 0, end = 0, inode = 0;
+
+        if (!take_number(line, start, 16) || !take_number(line, end, 16))
+            return false;
+
+        auto perms = take_field(line);
+
+        if (perms.size() < 4)
+            return false;
+
+        take_field(line);   // offset
+        take_field(line);   // dev
+
+        if (!take_number(line, inode, 10))
+            return false;
+
+        while (!line.empty() && line.front() == ' ')
+            line.remove_prefix(1);
+
+        info.base = start;
+        info.size = static_cast<size_t>(end - start);
+
+        info.protection = protection_none;
+        if (perms[0] == 'r') info.protection |= protection_read;
+        if (perms[1] == 'w') info.protection |= protection_write;
+        if (perms[2] == 'x') info.protection |= protection_execute;
+        if (perms[3] == 'p' && (info.protection & protection_write)) info.protection |= protection_copy_on_write;
+
+        // PROT_NONE mappings are address space reservations, the closest thing to MEM_RESERVE.
+        info.state = info.protection == protection_none ? region_state::reserved : region_state::committed;
+
+        bool has_path = !line.empty() && line.front() == '/';
+
+        if (path)
+            *path = line;
+
+        if (perms[3] == 's')
+            info.kind = region_kind::mapped;
+        else if (inode != 0 && has_path)
+            info.kind = region_kind::image;
+        else
+            info.kind = region_kind::private_memory;
+
+        return true;
+    }
+
+    // The whole file is taken with plain reads, the kernel produces it a page at a time anyway.
+    std::string read_maps() {
+        std::string text;
+        auto path = "/proc/" + std::to_string(_pid) + "/maps";
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0)
+            return text;
+
+        size_t used = 0;
+        text.resize(64 * 1024);
+
+        while (true) {
+            if (used == text.size())
+                text.resize(text.size() * 2);
+
+            ssize_t count = ::read(fd, text.data() + used, text.size() - used);
+
+            if (count <= 0)
+                break;
+
+            used += static_cast<size_t>(count);
+        }
+
+        ::close(fd);
+        text.resize(used);
+        return text;
+    }
+
+    // Reads are issued by several workers, the descriptor is opened once by the first one that needs it.
+    bool open_mem_file() {
+        std::call_once(_mem_fd_once, [this]() {
+            auto path = "/proc/" + std::to_string(_pid) + "/mem";
+            _mem_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        });
+        return _mem_fd >= 0;
+    }
+
+    bool open_pagemap() {
+        std::call_once(_pagemap_fd_once, [this]() {
+            auto path = "/proc/" + std::to_string(_pid) + "/pagemap";
+            _pagemap_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        });
+        return _pagemap_fd >= 0;
+    }
+
+    // Bit 55 of a pagemap entry, set by the kernel when the page is written after a clear_refs reset.
+    static constexpr uint64_t PAGEMAP_SOFT_DIRTY = 1ull << 55;
+
+    // Bits 63 and 62, the page is resident or swapped out.
+    static constexpr uint64_t PAGEMAP_PRESENT = 1ull << 63;
+    static constexpr uint64_t PAGEMAP_SWAPPED = 1ull << 62;
+
+    // Bits 0 to 54 hold the page frame of a resident page, only privileged readers see it.
+    static constexpr uint64_t PAGEMAP_FRAME = (1ull << 55) - 1;
+
+    // Untouched anonymous pages that were read are mapped to the shared zero page, they still hold zeros.
+    // Its frame is found by reading a page of this process, 0 when frames are hidden.
+    static uint64_t zero_page_frame() {
+        static const uint64_t frame = []() -> uint64_t {
+            auto page = static_cast<volatile uint8_t*>(::mmap(nullptr, TRACKING_PAGE_BYTES, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+            if (page == MAP_FAILED)
+                return 0;
+
+            uint8_t touch = page[0];
+            (void)touch;
+
+            uint64_t entry = 0;
+            int fd = ::open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+
+            if (fd >= 0) {
+                auto entry_offset = static_cast<off_t>(reinterpret_cast<uint64_t>(page) / TRACKING_PAGE_BYTES * sizeof(uint64_t));
+
+                if (::pread(fd, &entry, sizeof(entry), entry_offset) != sizeof(entry))
+                    entry = 0;
+
+                ::close(fd);
+            }
+
+            ::munmap(const_cast<uint8_t*>(page), TRACKING_PAGE_BYTES);
+            return (entry & PAGEMAP_PRESENT) ? entry & PAGEMAP_FRAME : 0;
+        }();
+
+        return frame;
+    }
+
+    // Sets a bit per page of [address, address + size) whose pagemap entry passes accept(entry).
+    template<typename Accept>
+    bool query_pagemap(uint64_t address, size_t size, Accept&& accept, std::vector<uint64_t>& bits) {
+        if (sysconf(_SC_PAGESIZE) != static_cast<long>(TRACKING_PAGE_BYTES) || !open_pagemap())
+            return false;
+
+        size_t pages = (size + TRACKING_PAGE_BYTES - 1) / TRACKING_PAGE_BYTES;
+        uint64_t first_page = address / TRACKING_PAGE_BYTES;
+
+        bits.assign((pages + 63) / 64, 0);
+
+        // One 8 byte entry per page, read in blocks.
+        constexpr size_t BLOCK_ENTRIES = 4096;
+        std::vector<uint64_t> entries(BLOCK_ENTRIES);
+
+        for (size_t block = 0; block < pages; block += BLOCK_ENTRIES) {
+            size_t count = std::min(BLOCK_ENTRIES, pages - block);
+            size_t bytes = count * sizeof(uint64_t);
+            auto offset = static_cast<off_t>((first_page + block) * sizeof(uint64_t));
+
+            if (::pread(_pagemap_fd, entries.data(), bytes, offset) != static_cast<ssize_t>(bytes))
+                return false;
+
+            for (size_t i = 0; i < count; i++) {
+                if (accept(entries[i]))
+                    bits[(block + i) / 64] |= 1ull << ((block + i) % 64);
+            }
+        }
+
+        return true;
+    }
+
+    static bool write_clear_refs(const std::string& path) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+
+        if (fd < 0)
+            return false;
+
+        // 4 clears the soft-dirty bits of every page of the process.
+        bool done = ::write(fd, "4", 1) == 1;
+        ::close(fd);
+        return done;
+    }
+
+    // Kernels built without soft-dirty accept the reset but never set the bit. Where it is supported a
+    // freshly faulted page is always soft-dirty, so a new page of this process tells them apart without
+    // clearing the bits of any existing page.
+    static bool soft_dirty_supported() {
+        static const bool supported = []() {
+            if (sysconf(_SC_PAGESIZE) != static_cast<long>(TRACKING_PAGE_BYTES))
+                return false;
+
+            auto page = static_cast<volatile uint8_t*>(::mmap(nullptr, TRACKING_PAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+            if (page == MAP_FAILED)
+                return false;
+
+            page[0] = 1;
+
+            bool result = false;
+            int fd = ::open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+
+            if (fd >= 0) {
+                auto entry_offset = static_cast<off_t>(reinterpret_cast<uint64_t>(page) / TRACKING_PAGE_BYTES * sizeof(uint64_t));
+                uint64_t entry = 0;
+
+                result = ::pread(fd, &entry, sizeof(entry), entry_offset) == sizeof(entry) && (entry & PAGEMAP_SOFT_DIRTY);
+                ::close(fd);
+            }
+
+            ::munmap(const_cast<uint8_t*>(page), TRACKING_PAGE_BYTES);
+            return result;
+        }();
+
+        return supported;
+    }
+
+    bool read_mem_file(read_request& request) {
+        request.bytes_read = 0;
+
+        if (!open_mem_file())
+            return false;
+
+        while (request.bytes_read < request.size) {
+            auto done = ::pread(_mem_fd,
+                static_cast<uint8_t*>(request.buffer) + request.bytes_read,
+                request.size - request.bytes_read,
+                static_cast<off_t>(request.address + request.bytes_read));
+
+            if (done < 0 && errno == EINTR)
+                continue;
+            if (done <= 0)
+                break;
+
+            request.bytes_read += static_cast<size_t>(done);
+        }
+        return request.bytes_read == request.size;
+    }
+
+    // Reads as many requests as possible with one process_vm_readv call.
+    // Returns how many requests were consumed, completed or failed, or 0 if the syscall is unusable.
+    size_t read_vectored(std::span<read_request> requests) {
+        size_t count = std::min(requests.size(), MAX_IOVECS);
+
+        std::vector<iovec> local(count);
+        std::vector<iovec> remote(count);
+
+        for (size_t i = 0; i < count; i++) {
+            local[i] = { requests[i].buffer, requests[i].size };
+            remote[i] = { reinterpret_cast<void*>(requests[i].address), requests[i].size };
+            requests[i].bytes_read = 0;
+        }
+
+        auto transferred = ::process_vm_readv(_pid, local.data(), count, remote.data(), count, 0);
+
+        if (transferred < 0) {
+            if (errno == ENOSYS || errno == EPERM) {
+                _use_mem_file = true;
+                return 0;
+            }
+            // The first range is not readable, the rest is retried with the next call.
+            return 1;
+        }
+
+        // The transfer stops at the first range that could not be read completely.
+        size_t remaining = static_cast<size_t>(transferred);
+        size_t consumed = 0;
+
+        while (consumed < count) {
+            auto& request = requests[consumed];
+
+            if (remaining < request.size) {
+                request.bytes_read = remaining;
+                consumed++;
+                break;
+            }
+
+            request.bytes_read = request.size;
+            remaining -= request.size;
+            consumed++;
+        }
+
+        return consumed;
+    }
+
+public:
+    explicit linux_process_access(pid_t pid) : _pid(pid) {}
+
+    ~linux_process_access() override {
+        if (_mem_fd >= 0)
+            ::close(_mem_fd);
+        if (_pagemap_fd >= 0)
+            ::close(_pagemap_fd);
+    }
+
+    std::vector<region_info> query_regions(uint64_t start, uint64_t end) override {
+        std::vector<region_info> regions;
+
+        auto maps = read_maps();
+        std::string_view text(maps);
+
+        while (!text.empty()) {
+            auto newline = text.find('\n');
+            auto line = text.substr(0, newline);
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+
+            region_info info;
+
+            if (!parse_line(line, info))
+                continue;
+
+            if (info.base + info.size <= start)
+                continue;
+
+            if (info.base >= end)
+                break;
+
+            if (info.base < start) {
+                info.size -= start - info.base;
+                info.base = start;
+            }
+
+            if (info.base + info.size > end)
+                info.size = end - info.base;
+
+            regions.push_back(info);
+        }
+
+        return regions;
+    }
+
+    std::vector<module_info> query_modules() override {
+        std::vector<module_info> modules;
+        std::string_view last_path;
+
+        auto maps = read_maps();
+        std::string_view text(maps);
+
+        while (!text.empty()) {
+            auto newline = text.find('\n');
+            auto line = text.substr(0, newline);
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+
+            region_info info;
+            std::string_view path;
+
+            if (!parse_line(line, info, &path) || info.kind != region_kind::image)
+                continue;
+
+            // The loader maps the segments of a file one after the other, anonymous mappings may sit in between.
+            if (path == last_path) {
+                modules.back().size = static_cast<size_t>(info.base + info.size - modules.back().base);
+                continue;
+            }
+
+            modules.push_back({ std::string(path.substr(path.rfind('/') + 1)), info.base, info.size });
+            last_path = path;
+        }
+
+        return modules;
+    }
+
+    bool read(uint64_t address, void* buffer, size_t size, size_t* bytes_read) override {
+        read_request request{ address, buffer, size };
+
+        read_batch(std::span<read_request>(&request, 1));
+
+        if (bytes_read) {
+            *bytes_read = request.bytes_read;
+        }
+        return request.bytes_read == size;
+    }
+
+    bool reset_written_pages() override {
+        if (!soft_dirty_supported())
+            return false;
+
+        return write_clear_refs("/proc/" + std::to_string(_pid) + "/clear_refs");
+    }
+
+    bool query_written_pages(uint64_t address, size_t size, std::vector<uint64_t>& written) override {
+        if (!soft_dirty_supported())
+            return false;
+
+        return query_pagemap(address, size, [](uint64_t entry) { return (entry & PAGEMAP_SOFT_DIRTY) != 0; }, written);
+    }
+
+    bool query_populated_pages(uint64_t address, size_t size, std::vector<uint64_t>& populated) override {
+        uint64_t zero_frame = zero_page_frame();
+
+        return query_pagemap(address, size, [zero_frame](uint64_t entry) {
+            if (entry & PAGEMAP_SWAPPED)
+                return true;
+
+            return (entry & PAGEMAP_PRESENT) && (zero_frame == 0 || (entry & PAGEMAP_FRAME) != zero_frame);
+        }, populated);
+    }
+
+    size_t read_batch(std::span<read_request> requests) override {
+        size_t completed = 0;
+        size_t position = 0;
+
+        while (position < requests.size()) {
+            size_t consumed = 0;
+
+            if (!_use_mem_file)
+                consumed = read_vectored(requests.subspan(position));
+
+            if (consumed == 0) {
+                // process_vm_readv is not available, fall back to /proc/<pid>/mem.
+                if (read_mem_file(requests[position]))
+                    completed++;
+                position++;
+                continue;
+            }
+
+            for (size_t i = position; i < position + consumed; i++) {
+                if (requests[i].bytes_read == requests[i].size)
+                    completed++;
+            }
+            position += consumed;
+        }
+
+        return completed;
+    }
+};
+
+std::unique_ptr<process_access> process_access::open(long process_id)
+{
+    return std::make_unique<linux_process_access>(static_cast<pid_t>(process_id));
+}
+#endif
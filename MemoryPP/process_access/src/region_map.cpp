@@ -0,0 +1,46 @@
+#include "../region_map.hpp"
+
+namespace {
+
+bool same_region(const region_info& lhs, const region_info& rhs)
+{
+    return lhs.size == rhs.size && lhs.protection == rhs.protection && lhs.state == rhs.state && lhs.kind == rhs.kind;
+}
+
+}
+
+const region_changes& region_map::update(uint64_t start, uint64_t end, std::vector<region_info> regions)
+{
+    _changes = region_changes();
+
+    if (start != _start || end != _end)
+        _regions.clear();
+
+    // Both lists are sorted by base, a single merge pass pairs them.
+    size_t old_index = 0;
+    size_t new_index = 0;
+
+    while (old_index < _regions.size() || new_index < regions.size()) {
+        if (new_index == regions.size() || (old_index < _regions.size() && _regions[old_index].base < regions[new_index].base)) {
+            _changes.removed.push_back(_regions[old_index++]);
+        }
+        else if (old_index == _regions.size() || regions[new_index].base < _regions[old_index].base) {
+            _changes.added.push_back(regions[new_index++]);
+        }
+        else {
+            if (same_region(_regions[old_index], regions[new_index]))
+                _changes.unchanged.push_back({ old_index, new_index });
+            else
+                _changes.changed.push_back(regions[new_index]);
+
+            old_index++;
+            new_index++;
+        }
+    }
+
+    _start = start;
+    _end = end;
+    _regions = std::move(regions);
+
+    return _changes;
+}
@@ -0,0 +1,139 @@
+#ifdef _WIN32
+#include "../process_access.hpp"
+#include <psapi.h>
+#include <algorithm>
+
+class windows_process_access : public process_access {
+    HANDLE _process;
+
+    static uint32_t translate_protection(DWORD protect) {
+        if (protect & (PAGE_GUARD | PAGE_NOACCESS))
+            return protection_none;
+
+        switch (protect & 0xFF) {
+        case PAGE_READONLY:          return protection_read;
+        case PAGE_READWRITE:         return protection_read | protection_write;
+        case PAGE_WRITECOPY:         return protection_read | protection_write | protection_copy_on_write;
+        case PAGE_EXECUTE:           return protection_execute;
+        case PAGE_EXECUTE_READ:      return protection_read | protection_execute;
+        case PAGE_EXECUTE_READWRITE: return protection_read | protection_write | protection_execute;
+        case PAGE_EXECUTE_WRITECOPY: return protection_read | protection_write | protection_execute | protection_copy_on_write;
+        default:                     return protection_none;
+        }
+    }
+
+    static region_info translate(const MEMORY_BASIC_INFORMATION& mbi) {
+        region_info info;
+        info.base = reinterpret_cast<uint64_t>(mbi.BaseAddress);
+        info.size = mbi.RegionSize;
+        info.protection = translate_protection(mbi.Protect);
+
+        switch (mbi.State) {
+        case MEM_COMMIT:  info.state = region_state::committed; break;
+        case MEM_RESERVE: info.state = region_state::reserved;  break;
+        default:          info.state = region_state::free;      break;
+        }
+
+        switch (mbi.Type) {
+        case MEM_IMAGE:  info.kind = region_kind::image;          break;
+        case MEM_MAPPED: info.kind = region_kind::mapped;         break;
+        default:         info.kind = region_kind::private_memory; break;
+        }
+        return info;
+    }
+
+public:
+    explicit windows_process_access(HANDLE process) : _process(process) {}
+
+    std::vector<region_info> query_regions(uint64_t start, uint64_t end) override {
+        std::vector<region_info> regions;
+
+        auto current_address = start;
+
+        while (current_address < end) {
+            MEMORY_BASIC_INFORMATION mbi;
+
+            if (VirtualQueryEx(_process, reinterpret_cast<LPCVOID>(current_address), &mbi, sizeof(mbi)) == 0) {
+                break;
+            }
+
+            auto info = translate(mbi);
+
+            if (info.base < start) {
+                info.size -= start - info.base;
+                info.base = start;
+            }
+
+            if (info.base + info.size > end)
+                info.size = end - info.base;
+
+            regions.push_back(info);
+
+            current_address = info.base + info.size;
+        }
+
+        return regions;
+    }
+
+    std::vector<module_info> query_modules() override {
+        std::vector<module_info> modules;
+        std::vector<HMODULE> handles(256);
+        DWORD needed = 0;
+
+        // The list may grow between two calls, retry until it fits.
+        while (true) {
+            DWORD bytes = static_cast<DWORD>(handles.size() * sizeof(HMODULE));
+
+            if (!K32EnumProcessModulesEx(_process, handles.data(), bytes, &needed, LIST_MODULES_ALL))
+                return modules;
+
+            if (needed <= bytes)
+                break;
+
+            handles.resize(needed / sizeof(HMODULE));
+        }
+
+        handles.resize(needed / sizeof(HMODULE));
+
+        for (auto handle : handles) {
+            MODULEINFO info{};
+            char name[MAX_PATH];
+
+            if (!K32GetModuleInformation(_process, handle, &info, sizeof(info)) || !K32GetModuleBaseNameA(_process, handle, name, MAX_PATH))
+                continue;
+
+            modules.push_back({ name, reinterpret_cast<uint64_t>(info.lpBaseOfDll), info.SizeOfImage });
+        }
+
+        std::sort(modules.begin(), modules.end(), [](const module_info& lhs, const module_info& rhs) {
+            return lhs.base < rhs.base;
+        });
+
+        return modules;
+    }
+
+    bool read(uint64_t address, void* buffer, size_t size, size_t* bytes_read) override {
+        SIZE_T local_bytes_read = 0;
+        BOOL ok = ReadProcessMemory(_process,
+            reinterpret_cast<LPCVOID>(address),
+            buffer,
+            size,
+            &local_bytes_read);
+        if (bytes_read) {
+            *bytes_read = static_cast<size_t>(local_bytes_read);
+        }
+        // Return true only if the full read succeeded.
+        return (ok && local_bytes_read == size);
+    }
+
+    // ReadProcessMemory has no vectored form, the default read_batch loop is used.
+
+    // QueryWorkingSetEx only reports the working set, a page trimmed to the page file would pass for an
+    // untouched one. Populated pages are left unknown and regions are read whole.
+};
+
+std::unique_ptr<process_access> process_access::open(long process_id)
+{
+    return std::make_unique<windows_process_access>(LongToHandle(process_id));
+}
+#endif
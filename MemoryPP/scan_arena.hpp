@@ -0,0 +1,79 @@
+#pragma once
+
+#include "platform.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Bump allocator for the region and result objects of one scan generation. Objects are never freed one at a time,
+// the blocks go away together once the last object allocated from them is destroyed.
+class scan_arena
+{
+    static constexpr size_t BLOCK_BYTES = 64 * 1024;
+
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<std::byte[]>> _blocks;
+    std::byte* _cursor{ nullptr };
+    size_t _left{ 0 };
+
+public:
+    scan_arena() = default;
+
+    scan_arena(const scan_arena&) = delete;
+    scan_arena& operator=(const scan_arena&) = delete;
+
+    // alignment is at most the one of operator new, which the blocks start on.
+    void* allocate(size_t size, size_t alignment) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        size_t padding = (alignment - reinterpret_cast<uintptr_t>(_cursor) % alignment) % alignment;
+
+        if (_cursor && padding + size <= _left) {
+            void* object = _cursor + padding;
+            _cursor += padding + size;
+            _left -= padding + size;
+            return object;
+        }
+
+        // Objects bigger than a block get one of their own, the current block keeps serving the others.
+        if (size > BLOCK_BYTES / 4) {
+            _blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(size));
+            return _blocks.back().get();
+        }
+
+        _blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(BLOCK_BYTES));
+        _cursor = _blocks.back().get() + size;
+        _left = BLOCK_BYTES - size;
+
+        return _blocks.back().get();
+    }
+};
+
+// Allocator for std::allocate_shared, every object holds on to the arena it came from.
+template<typename T>
+class arena_allocator
+{
+    template<typename U>
+    friend class arena_allocator;
+
+    std::shared_ptr<scan_arena> _arena;
+
+public:
+    using value_type = T;
+
+    explicit arena_allocator(std::shared_ptr<scan_arena> arena) : _arena(std::move(arena)) {}
+
+    template<typename U>
+    arena_allocator(const arena_allocator<U>& other) : _arena(other._arena) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(_arena->allocate(count * sizeof(T), alignof(T))); }
+
+    // Memory is released with the arena.
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const arena_allocator<U>& other) const { return _arena == other._arena; }
+};
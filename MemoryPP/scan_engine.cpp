@@ -1,61 +1,366 @@
 #include "scan_engine.hpp"
+#include <cstring>
 
 
-std::queue<std::shared_ptr<memory_region>> scan_engine::get_regions(std::pair<void*, void*> range, DWORD protection_flags)
+std::queue<std::shared_ptr<memory_region>> scan_engine::get_regions(std::pair<void*, void*> range, uint32_t protection_flags)
 {
     std::queue<std::shared_ptr<memory_region>> regions;
 
-    auto current_address = range.first;
+    if (!_access)
+        return regions;
 
-    HANDLE h_process = LongToHandle(this->get_pid());
+    uint64_t start = reinterpret_cast<uint64_t>(range.first);
+    uint64_t end = reinterpret_cast<uint64_t>(range.second);
 
-    while (current_address < range.second) {
-        MEMORY_BASIC_INFORMATION mbi;
+    auto& changes = _region_map.update(start, end, _access->query_regions(start, end));
+    auto current = _region_map.regions();
 
-        if (VirtualQueryEx(h_process, current_address, &mbi, sizeof(mbi)) == 0) {
-            break;
-        }
+    // The previous generation keeps its own arena, released with the last of its results.
+    _arena = std::make_shared<scan_arena>();
 
-        if (reinterpret_cast<BYTE*>(mbi.BaseAddress) < range.first)
-            mbi.BaseAddress = range.first;
+    // Regions held only here are done with, the unchanged ones carry over. The others are dropped.
+    std::vector<std::shared_ptr<memory_region>> kept(current.size());
+
+    for (auto [previous, position] : changes.unchanged) {
+        if (previous < _kept_regions.size() && _kept_regions[previous] && _kept_regions[previous].use_count() == 1)
+            kept[position] = std::move(_kept_regions[previous]);
+    }
 
-        if (reinterpret_cast<BYTE*>(mbi.BaseAddress) + mbi.RegionSize > range.second)
-            mbi.RegionSize = reinterpret_cast<uint64_t>(range.second) - reinterpret_cast<uint64_t>(mbi.BaseAddress);
+    _kept_regions = std::move(kept);
+    _kept_buffer_bytes = 0;
 
-        auto current_region = std::make_shared<memory_region>(mbi);
+    // Regions are only created for the ones the scan reads.
+    for (size_t position = 0; position < current.size(); position++) {
+        auto& info = current[position];
+        auto& region = _kept_regions[position];
 
+        if (!(info.protection & protection_flags) || info.state != region_state::committed || info.kind == region_kind::mapped) {
+            region.reset();
+            continue;
+        }
 
-        if (current_region && current_region->has_protection_flags(protection_flags) && current_region->is_commited() && !current_region->is_memmapped())
-            regions.push(current_region);
+        // A kept region moves into the new arena with its buffer, holding on to the object would keep the whole
+        // arena of its generation alive, results included.
+        if (region) {
+            region = make_scan_object<memory_region>(std::move(*region));
+            region->reuse(info);
+        }
+        else
+            region = make_scan_object<memory_region>(info);
 
-        current_address = reinterpret_cast<BYTE*>(mbi.BaseAddress) + mbi.RegionSize;
+        regions.push(region);
     }
 
     return regions;
 }
 
-bool scan_engine::read_memory(std::shared_ptr<memory_region> region)
+void scan_engine::retire_region(memory_region& region)
+{
+    size_t bytes = region.buffer_capacity();
+
+    if (bytes == 0)
+        return;
+
+    // Kept buffers are bounded like the ones the pool caches.
+    if (_kept_buffer_bytes.fetch_add(bytes) + bytes <= buffer_pool::shared().max_cached_bytes())
+        return;
+
+    _kept_buffer_bytes -= bytes;
+    region.release_buffer();
+}
+
+void scan_engine::retire_idle_regions()
+{
+    _kept_buffer_bytes = 0;
+
+    for (auto& region : _kept_regions) {
+        if (region && region.use_count() == 1)
+            retire_region(*region);
+    }
+}
+
+bool scan_engine::read_memory(const std::shared_ptr<memory_region>& region)
+{
+    return read_memory(std::span<const std::shared_ptr<memory_region>>(&region, 1)) == 1;
+}
+
+size_t scan_engine::read_memory(std::span<const std::shared_ptr<memory_region>> regions, bool populated_only)
+{
+    if (!_access)
+        return 0;
+
+    // Each region is filled through units, its whole buffer or the buffers of its runs, every unit by one or more reads.
+    std::vector<std::vector<read_request>> units(regions.size());
+    std::vector<std::vector<size_t>> first_read(regions.size());
+    std::vector<bool> sparse(regions.size(), false);
+    std::vector<read_request> reads;
+
+    reads.reserve(regions.size());
+
+    for (size_t i = 0; i < regions.size(); i++) {
+        auto& region = *regions[i];
+        bool known = query_populated(region);
+
+        auto runs = known && populated_only ? populated_runs(region) : std::vector<std::pair<size_t, size_t>>();
+        size_t run_bytes = 0;
+
+        for (auto& run : runs)
+            run_bytes += run.second;
+
+        sparse[i] = known && populated_only && run_bytes * 2 <= region.size();
+
+        if (sparse[i])
+            units[i] = region.prepare_sparse_read(runs);
+        else
+            units[i].push_back(region.prepare_read());
+
+        for (auto& unit : units[i]) {
+            first_read[i].push_back(reads.size());
+            append_reads(region, unit, reads);
+        }
+
+        first_read[i].push_back(reads.size());
+    }
+
+    if (!reads.empty())
+        _access->read_batch(reads);
+
+    size_t completed = 0;
+
+    for (size_t i = 0; i < regions.size(); i++) {
+        // A unit is read once every one of its reads is.
+        for (size_t u = 0; u < units[i].size(); u++) {
+            bool whole = std::all_of(reads.begin() + first_read[i][u], reads.begin() + first_read[i][u + 1],
+                [](const read_request& read) { return read.bytes_read == read.size; });
+
+            units[i][u].bytes_read = whole ? units[i][u].size : 0;
+        }
+
+        bool success = sparse[i] ? regions[i]->complete_sparse_read(units[i]) : regions[i]->complete_read(units[i][0]);
+
+        if (success)
+            completed++;
+    }
+
+    return completed;
+}
+
+bool scan_engine::query_populated(memory_region& region)
+{
+    std::vector<uint64_t> populated;
+
+    // Only anonymous pages read as zero when untouched, pages of files hold the file.
+    bool known = _skip_unpopulated && region.is_private() && _access->query_populated_pages(region.base(), region.size(), populated);
+    region.set_populated_pages(known ? std::move(populated) : std::vector<uint64_t>());
+
+    return known;
+}
+
+bool scan_engine::should_stream(memory_region& region, bool populated_only)
+{
+    if (region.size() <= READ_BATCH_BYTES)
+        return false;
+
+    if (!populated_only || !query_populated(region))
+        return true;
+
+    // Same choice as read_memory, a sparse read holds the populated runs only.
+    size_t run_bytes = 0;
+
+    for (auto& run : populated_runs(region))
+        run_bytes += run.second;
+
+    return run_bytes * 2 > region.size() || run_bytes > READ_BATCH_BYTES;
+}
+
+std::vector<std::pair<size_t, size_t>> scan_engine::populated_runs(memory_region& region)
+{
+    constexpr size_t PAGE_BYTES = memory_region::PAGE_BYTES;
+
+    std::vector<std::pair<size_t, size_t>> runs;
+    size_t pages = (region.size() + PAGE_BYTES - 1) / PAGE_BYTES;
+
+    for (size_t page = 0; page < pages; page++) {
+        if (!region.page_populated(page))
+            continue;
+
+        // Widened by a page on each side, a value may reach into either of them.
+        size_t first = page > 0 ? page - 1 : 0;
+        size_t last = std::min(pages, page + 2);
+
+        if (!runs.empty() && first * PAGE_BYTES <= runs.back().first + runs.back().second)
+            runs.back().second = std::min(region.size(), last * PAGE_BYTES) - runs.back().first;
+        else
+            runs.push_back({ first * PAGE_BYTES, std::min(region.size(), last * PAGE_BYTES) - first * PAGE_BYTES });
+    }
+
+    return runs;
+}
+
+void scan_engine::append_reads(memory_region& region, const read_request& unit, std::vector<read_request>& reads)
+{
+    constexpr size_t PAGE_BYTES = memory_region::PAGE_BYTES;
+
+    if (!region.has_populated_pages()) {
+        reads.push_back(unit);
+        return;
+    }
+
+    // Units start on a page of the region.
+    auto buffer = static_cast<uint8_t*>(unit.buffer);
+    size_t first_page = static_cast<size_t>(unit.address - region.base()) / PAGE_BYTES;
+    size_t pages = (unit.size + PAGE_BYTES - 1) / PAGE_BYTES;
+
+    for (size_t page = 0; page < pages;) {
+        bool read = region.page_populated(first_page + page);
+        size_t end = page + 1;
+
+        while (end < pages && region.page_populated(first_page + end) == read)
+            end++;
+
+        size_t offset = page * PAGE_BYTES;
+        size_t size = std::min(end * PAGE_BYTES, unit.size) - offset;
+
+        if (read)
+            reads.push_back({ unit.address + offset, buffer + offset, size });
+        else
+            std::memset(buffer + offset, 0, size);
+
+        page = end;
+    }
+}
+
+bool scan_engine::read_candidates(const std::shared_ptr<memory_region>& region, std::vector<std::pair<size_t, size_t>>& runs)
+{
+    if (!_access || runs.empty())
+        return false;
+
+    // Runs of several previous results may interleave.
+    std::sort(runs.begin(), runs.end());
+
+    std::vector<std::pair<size_t, size_t>> merged;
+    size_t total = 0;
+
+    for (auto& [offset, size] : runs) {
+        if (!merged.empty() && offset <= merged.back().first + merged.back().second + CANDIDATE_GAP_BYTES) {
+            auto& last = merged.back();
+            last.second = std::max(last.first + last.second, offset + size) - last.first;
+        }
+        else {
+            merged.push_back({ offset, size });
+        }
+    }
+
+    for (auto& run : merged)
+        total += run.second;
+
+    if (total * 2 > region->size())
+        return read_memory(region);
+
+    auto requests = region->prepare_sparse_read(merged);
+    _access->read_batch(requests);
+
+    return region->complete_sparse_read(requests);
+}
+
+void scan_engine::track_writes(std::queue<std::shared_ptr<memory_region>>& regions)
+{
+    if (!_access || !_track_writes) {
+        _tracking = false;
+        return;
+    }
+
+    // The pages written since the last reset are collected before the next reset clears them.
+    // Every region is moved to the back of the queue, which ends up in its original order.
+    if (_tracking) {
+        for (size_t count = regions.size(); count > 0; count--) {
+            auto region = std::move(regions.front());
+            std::vector<uint64_t> written;
+
+            regions.pop();
+
+            if (_access->query_written_pages(region->base(), region->size(), written))
+                region->set_written_pages(std::move(written));
+
+            regions.push(std::move(region));
+        }
+    }
+
+    _tracking = _access->reset_written_pages();
+}
+
+bool scan_engine::read_changed(const std::shared_ptr<memory_region>& region, memory_region& previous)
 {
-    size_t bytes_read = 0;
+    if (!_access)
+        return false;
+
+    if (!region->has_written_pages() || !previous.is_valid() || previous.is_sparse() || previous.is_streamed())
+        return read_memory(region);
+
+    constexpr size_t PAGE_BYTES = memory_region::PAGE_BYTES;
+
+    auto request = region->prepare_read();
+    auto buffer = static_cast<uint8_t*>(request.buffer);
+
+    uint64_t previous_begin = previous.base();
+    uint64_t previous_end = previous_begin + previous.size();
+
+    // A page can be copied when it was not written and the previous region holds it on the same page boundary.
+    auto clean = [&](size_t page) {
+        uint64_t address = region->base() + page * PAGE_BYTES;
+        uint64_t end = std::min<uint64_t>(address + PAGE_BYTES, region->base() + request.size);
+
+        return !region->page_written(page) && address >= previous_begin && end <= previous_end && (address - previous_begin) % PAGE_BYTES == 0;
+    };
+
+    size_t pages = (request.size + PAGE_BYTES - 1) / PAGE_BYTES;
+    std::vector<read_request> reads;
+
+    for (size_t page = 0; page < pages;) {
+        bool copy = clean(page);
+        size_t end = page + 1;
+
+        while (end < pages && clean(end) == copy)
+            end++;
 
-    HANDLE h_process = LongToHandle(this->get_pid());
+        size_t offset = page * PAGE_BYTES;
+        size_t size = std::min(end * PAGE_BYTES, request.size) - offset;
+        uint64_t address = region->base() + offset;
 
-    auto success = region->read_data(
-        [h_process](uint64_t address, void* buffer, size_t size, size_t* bytes_read_ptr) -> bool {
-            SIZE_T local_bytes_read = 0;
-            BOOL ok = ReadProcessMemory(h_process,
-                reinterpret_cast<LPCVOID>(address),
-                buffer,
-                size,
-                &local_bytes_read);
-            if (bytes_read_ptr) {
-                *bytes_read_ptr = static_cast<size_t>(local_bytes_read);
-            }
-            // Return true only if the full read succeeded.
-            return (ok && local_bytes_read == size);
-        },
-        bytes_read
-    );
+        if (copy && previous.read_snapshot(static_cast<size_t>(address - previous_begin), size, buffer + offset)) {
+            size_t previous_page = static_cast<size_t>(address - previous_begin) / PAGE_BYTES;
+
+            for (size_t k = page; k < end; k++)
+                region->set_page_hash(k, previous.page_hash(previous_page + (k - page)));
+        }
+        else {
+            reads.push_back({ address, buffer + offset, size });
+        }
+
+        page = end;
+    }
+
+    size_t completed = reads.empty() ? 0 : _access->read_batch(reads);
+    request.bytes_read = completed == reads.size() ? request.size : 0;
+
+    return region->complete_read(request);
+}
+
+std::vector<std::shared_ptr<memory_region>> scan_engine::pop_batch(std::queue<std::shared_ptr<memory_region>>& regions)
+{
+    std::vector<std::shared_ptr<memory_region>> batch;
+    size_t batch_bytes = 0;
+
+    while (!regions.empty()) {
+        auto& region = regions.front();
+
+        if (!batch.empty() && batch_bytes + region->size() > READ_BATCH_BYTES)
+            break;
+
+        batch_bytes += region->size();
+        batch.push_back(std::move(region));
+        regions.pop();
+    }
 
-    return success;
+    return batch;
 }
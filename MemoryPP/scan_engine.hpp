@@ -3,43 +3,378 @@
 #include <queue>
 #include <map>
 #include <mutex>
-#include <functional>
 #include <optional>
+#include <algorithm>
 #include "scan_result/scan_result.hpp"
+#include "memory_reagion/region_index.hpp"
+#include "scan_predicate.hpp"
+#include "process_access/process_access.hpp"
+#include "process_access/region_map.hpp"
 #include "custom_map.hpp"
+#include "scan_arena.hpp"
+#include "thread_pool.hpp"
 
 
 class scan_engine {
 protected:
+    // Upper bound of bytes fetched by a single batched read.
+    static constexpr size_t READ_BATCH_BYTES = 16 * 1024 * 1024;
+
+    // Regions bigger than this are searched in slices by separate tasks.
+    static constexpr size_t SLICE_BYTES = 4 * 1024 * 1024;
+
     long _pid{ -1 };
     char _current_scan{ 0 };
 
-    std::queue<std::shared_ptr<memory_region>> get_regions(std::pair<void*, void*> range, DWORD protection_flags);
-    bool read_memory(std::shared_ptr<memory_region> region);
+    // Distance in bytes between the values compared by a scan, 0 steps by the size of the value.
+    size_t _alignment{ 0 };
+
+    // unknown_value snapshots leave the pages made of a single repeated byte out of the dump.
+    bool _compress_snapshots{ true };
+
+    // Regions are hashed per page as they are read, relative scans settle the pages that did not change in bulk.
+    bool _hash_pages{ true };
+
+    // Writes of the target are tracked between scans where the host supports it, so next scans copy the pages
+    // left untouched from the previous scan instead of reading them. A reset affects the whole target, so only
+    // one engine per target process may track writes.
+    bool _track_writes{ false };
+    bool _tracking{ false };    // The last scan started a tracking period.
+
+    // Pages of private regions the target never touched are left unread where the host can tell them apart.
+    // They hold zeros, first scans leave them out of the region when zero can't match.
+    bool _skip_unpopulated{ true };
+    std::shared_ptr<process_access> _access;
+    std::shared_ptr<thread_pool> _pool;
+
+    // One chunk buffer per worker of the pool plus one for outside threads, see stream_region.
+    std::vector<region_buffer> _chunk_buffers;
+
+    // Regions of the last enumerated range, compared with every new enumeration.
+    region_map _region_map;
+
+    // The region objects of the last enumeration by position in _region_map, null for those the scan left out.
+    // Unchanged regions nothing else holds anymore are handed out again with their buffer.
+    std::vector<std::shared_ptr<memory_region>> _kept_regions;
+    std::atomic<size_t> _kept_buffer_bytes{ 0 };
+
+    // Arena of the current scan generation, replaced by get_regions. See make_scan_object.
+    std::shared_ptr<scan_arena> _arena{ std::make_shared<scan_arena>() };
+
+    // Regions and results are allocated together with their control block from the arena of the scan that made them.
+    // The memory of a generation is released in bulk once its last object is dropped.
+    template<typename T, typename... Args>
+    __forceinline std::shared_ptr<T> make_scan_object(Args&&... args) {
+        return std::allocate_shared<T>(arena_allocator<T>(_arena), std::forward<Args>(args)...);
+    }
+
+    // Starts a new scan generation. Regions the target left unchanged reuse the objects of the previous one when no
+    // result holds them anymore, see _kept_regions.
+    std::queue<std::shared_ptr<memory_region>> get_regions(std::pair<void*, void*> range, uint32_t protection_flags);
+
+    // Called once a scan is done with region. Its buffer stays attached for the next scan while the buffers kept
+    // this way fit in the cache limit of the buffer pool, beyond it the buffer goes back to the pool.
+    void retire_region(memory_region& region);
+
+    // Retires every kept region no result holds, at the end of a scan.
+    void retire_idle_regions();
+    bool read_memory(const std::shared_ptr<memory_region>& region);
+
+    // populated_only reads the regions made mostly of unpopulated pages as sparse regions, for scans zero can't match.
+    // Each run of populated pages comes with the zeroed page on either side, so every value starting in a run lies in it.
+    size_t read_memory(std::span<const std::shared_ptr<memory_region>> regions, bool populated_only = false);
+
+    // Asks the host for the populated pages of region, returns whether they are known.
+    bool query_populated(memory_region& region);
+
+    // Regions bigger than a read batch are never held whole. Their chunks of SLICE_BYTES are read and searched
+    // by separate tasks of group, so the reads of some chunks overlap the search of others and memory stays
+    // bounded by one chunk per worker. search(bytes, offset, size) gets the chunk at offset followed by up to
+    // overlap bytes of the next one. Chunks made only of unpopulated pages are skipped when populated_only is set.
+    template<typename Search>
+    void stream_region(task_group& group, std::shared_ptr<memory_region> region, size_t overlap, bool populated_only, Search search);
+
+    // Whether region is too big to be held whole, and still is when only its populated pages would be read.
+    bool should_stream(memory_region& region, bool populated_only);
+
+    // Page runs of region holding its populated pages and the pages around them.
+    static std::vector<std::pair<size_t, size_t>> populated_runs(memory_region& region);
+
+    // Appends the reads filling unit, one per run of populated pages when those are known, the other pages are zeroed.
+    void append_reads(memory_region& region, const read_request& unit, std::vector<read_request>& reads);
+
+    // Pops regions from the queue until READ_BATCH_BYTES is reached, the batch is meant for a single read_memory call.
+    std::vector<std::shared_ptr<memory_region>> pop_batch(std::queue<std::shared_ptr<memory_region>>& regions);
+
+    // Next scans only fetch the pages holding the previous hits when those cover a small part of a region.
+    static constexpr size_t CANDIDATE_PAGE_BYTES = 4096;
+
+    // Runs closer than this are read as one, a slightly longer read costs less than one more request.
+    static constexpr size_t CANDIDATE_GAP_BYTES = 4 * CANDIDATE_PAGE_BYTES;
+
+    // Appends the (offset, size) page runs of region holding the hits of previous.
+    // Returns false when previous needs the whole region, snapshots and bitmaps read their values from it.
+    template<typename DataType>
+    static bool candidate_pages(memory_region& region, scan_result<DataType>& previous, std::vector<std::pair<size_t, size_t>>& runs);
+
+    // Bytes of values a next scan compares in region for the previous results, their entries or the whole region.
+    // Positions are scheduled largest first by it, those above SLICE_BYTES are rescanned in windows by separate tasks.
+    template<typename DataType>
+    static size_t rescan_work(memory_region& region, std::span<scan_result<DataType>* const> previous);
+
+    // Reads the runs of region with one batched read, or the whole region once they cover most of it.
+    bool read_candidates(const std::shared_ptr<memory_region>& region, std::vector<std::pair<size_t, size_t>>& runs);
+
+    // Tags the regions with the pages written since the previous scan, then starts a new tracking period.
+    void track_writes(std::queue<std::shared_ptr<memory_region>>& regions);
+
+    // Reads the pages of region the target wrote, copying the others from previous.
+    // Regions without write tracking are read whole.
+    bool read_changed(const std::shared_ptr<memory_region>& region, memory_region& previous);
+
+    // Saves the region read for an unknown_value scan and releases its memory.
+    __forceinline bool dump_snapshot(memory_region& region) { return _compress_snapshots ? region.dump_compressed() : region.dump(true); }
+
+    // Reads the regions in batches and calls search(data, size, base, out) over slices of each of them.
+    // Slices overlap by overlap bytes so matches across a cut are found, and kept by the slice they start in.
+    // Returns the matches, which carry an address, in region and slice order.
+    template<typename Match, typename Search>
+    std::vector<Match> search_regions(std::queue<std::shared_ptr<memory_region>>& regions, size_t overlap, Search&& search);
 
 public:
-    scan_engine(long process_id) : _pid(process_id) {}
+    // Engines run on the process wide pool unless a dedicated one is given.
+    scan_engine(long process_id, std::shared_ptr<thread_pool> pool = nullptr)
+        : _pid(process_id), _access(process_access::open(process_id)), _pool(pool ? std::move(pool) : thread_pool::shared()), _chunk_buffers(_pool->size() + 1) {}
+    scan_engine(std::shared_ptr<process_access> access, std::shared_ptr<thread_pool> pool = nullptr)
+        : _access(std::move(access)), _pool(pool ? std::move(pool) : thread_pool::shared()), _chunk_buffers(_pool->size() + 1) {}
     virtual ~scan_engine() = default;
 
     __forceinline long get_pid() const { return _pid; }
-    __forceinline void set_pid(long pid) { _pid = pid; }
+    __forceinline void set_pid(long pid) { _pid = pid; _access = process_access::open(pid); }
+
+    // 1 finds every unaligned value, larger strides compare proportionally less data.
+    // Next scans over an unknown_value snapshot must use the stride the snapshot was taken with.
+    __forceinline size_t get_alignment() const { return _alignment; }
+    __forceinline void set_alignment(size_t alignment) { _alignment = alignment; }
+
+    __forceinline bool get_snapshot_compression() const { return _compress_snapshots; }
+    __forceinline void set_snapshot_compression(bool enabled) { _compress_snapshots = enabled; }
+
+    __forceinline bool get_page_hashing() const { return _hash_pages; }
+    __forceinline void set_page_hashing(bool enabled) { _hash_pages = enabled; }
+
+    __forceinline bool get_write_tracking() const { return _track_writes; }
+    __forceinline void set_write_tracking(bool enabled) { _track_writes = enabled; _tracking = false; }
+
+    // What the target mapped, unmapped or reprotected between the last two scans of the same range.
+    __forceinline const region_changes& get_region_changes() const { return _region_map.changes(); }
+
+    __forceinline bool get_skip_unpopulated() const { return _skip_unpopulated; }
+    __forceinline void set_skip_unpopulated(bool enabled) { _skip_unpopulated = enabled; }
 };
 
+template<typename Search>
+inline void scan_engine::stream_region(task_group& group, std::shared_ptr<memory_region> region, size_t overlap, bool populated_only, Search search)
+{
+    if (!_access)
+        return;
+
+    query_populated(*region);
+    region->begin_stream();
+
+    size_t chunks = (region->size() + SLICE_BYTES - 1) / SLICE_BYTES;
+
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        group.run([this, region, overlap, populated_only, search, chunk]() {
+            constexpr size_t PAGE_BYTES = memory_region::PAGE_BYTES;
+
+            size_t offset = chunk * SLICE_BYTES;
+            size_t size = std::min(SLICE_BYTES, region->size() - offset);
+            size_t held = std::min(region->size() - offset, size + overlap);
+
+            bool populated = !region->has_populated_pages();
+
+            for (size_t page = offset / PAGE_BYTES; !populated && page * PAGE_BYTES < offset + held; page++)
+                populated = region->page_populated(page);
+
+            if (populated_only && !populated)
+                return;
+
+            // Workers run one chunk at a time, their buffer only grows to the largest chunk. Its old bytes are not kept.
+            auto& buffer = _chunk_buffers[_pool->worker_index()];
+
+            if (buffer.size() < held) {
+                buffer.clear();
+                buffer.resize(held);
+            }
+
+            std::vector<read_request> reads;
+            append_reads(*region, { region->base() + offset, buffer.data(), held }, reads);
+
+            if (!reads.empty() && _access->read_batch(reads) != reads.size())
+                return;
+
+            if (_hash_pages)
+                region->hash_range(buffer.data(), offset, size);
+
+            search(buffer.data(), offset, size);
+        }, 1);
+    }
+}
+
+template<typename DataType>
+inline bool scan_engine::candidate_pages(memory_region& region, scan_result<DataType>& previous, std::vector<std::pair<size_t, size_t>>& runs)
+{
+    if (previous.type() == scan_type::unknown_value || previous.encoding() != result_encoding::entries)
+        return false;
+
+    uint64_t region_begin = region.base();
+    uint64_t region_end = region_begin + region.size();
+    uint64_t previous_base = previous.region_base();
+    size_t count = previous.values().size();
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t address = previous_base + previous.offset_at(i);
+
+        if (address < region_begin || address + sizeof(DataType) > region_end)
+            continue;
+
+        size_t first = static_cast<size_t>(address - region_begin) / CANDIDATE_PAGE_BYTES * CANDIDATE_PAGE_BYTES;
+        size_t last = std::min(region.size(), (static_cast<size_t>(address - region_begin) + sizeof(DataType) + CANDIDATE_PAGE_BYTES - 1) / CANDIDATE_PAGE_BYTES * CANDIDATE_PAGE_BYTES);
+
+        // Hits are sorted, consecutive ones on the same or the next page extend the last run.
+        if (!runs.empty() && first <= runs.back().first + runs.back().second)
+            runs.back().second = std::max(runs.back().first + runs.back().second, last) - runs.back().first;
+        else
+            runs.push_back({ first, last - first });
+    }
+
+    return true;
+}
+
+template<typename DataType>
+inline size_t scan_engine::rescan_work(memory_region& region, std::span<scan_result<DataType>* const> previous)
+{
+    size_t work = 0;
+
+    for (auto old_scan : previous) {
+        if (old_scan->type() != scan_type::unknown_value && old_scan->encoding() == result_encoding::entries)
+            work += old_scan->count() * sizeof(DataType);
+        else
+            work += region.size();
+    }
+
+    return std::min(work, region.size());
+}
+
+template<typename Match, typename Search>
+inline std::vector<Match> scan_engine::search_regions(std::queue<std::shared_ptr<memory_region>>& regions, size_t overlap, Search&& search)
+{
+    // One list per slice of every region, filled by the task that searched it.
+    std::vector<std::vector<std::vector<Match>>> slots(regions.size());
+
+    {
+        task_group group(*_pool);
+        size_t i = 0;
+
+        while (!regions.empty()) {
+
+            auto batch = pop_batch(regions);
+            size_t first_index = i;
+            i += batch.size();
+
+            group.run([&, batch = std::move(batch), first_index]() mutable {
+
+                // Regions bigger than a read batch come alone, their chunks are searched as they are read.
+                if (batch.size() == 1 && should_stream(*batch[0], false)) {
+                    auto current_region = batch[0];
+                    auto& slices = slots[first_index];
+                    slices.resize((current_region->size() + SLICE_BYTES - 1) / SLICE_BYTES);
+
+                    stream_region(group, current_region, overlap, false, [&, current_region](const uint8_t* bytes, size_t offset, size_t size) {
+                        auto& out = slices[offset / SLICE_BYTES];
+                        size_t held = std::min(current_region->size() - offset, size + overlap);
+
+                        search(bytes, held, current_region->base() + offset, out);
+                        std::erase_if(out, [&](const Match& match) { return match.address >= current_region->base() + offset + size; });
+                    });
+
+                    return;
+                }
+
+                read_memory(batch);
+
+                for (size_t k = 0; k < batch.size(); k++) {
+                    auto current_region = batch[k];
+                    auto& slices = slots[first_index + k];
+
+                    if (!current_region->is_valid())
+                        continue;
+
+                    auto data = current_region->view();
+                    size_t count = (data.size() + SLICE_BYTES - 1) / SLICE_BYTES;
+                    slices.resize(count);
+
+                    // The slice searched last retires the region.
+                    auto pending = count > 1 ? make_scan_object<std::atomic<size_t>>(count) : nullptr;
+
+                    for (size_t slice = 0; slice < count; slice++) {
+
+                        auto search_slice = [&, current_region, data, slice, pending, &out = slices[slice]]() {
+                            size_t begin = slice * SLICE_BYTES;
+                            size_t end = std::min(data.size(), begin + SLICE_BYTES);
+                            size_t search_end = std::min(data.size(), end + overlap);
+
+                            search(data.data() + begin, search_end - begin, current_region->base() + begin, out);
+
+                            // Matches starting in the overlap belong to the next slice.
+                            std::erase_if(out, [&](const Match& match) { return match.address >= current_region->base() + end; });
+
+                            if (!pending || --*pending == 0)
+                                retire_region(*current_region);
+                        };
+
+                        if (count == 1)
+                            search_slice();
+                        else
+                            group.run(search_slice, 1);
+                    }
+                }
+            });
+        }
+
+        group.wait();
+    }
+
+    std::vector<Match> matches;
+
+    for (auto& slices : slots) {
+        for (auto& slice : slices)
+            matches.insert(matches.end(), slice.begin(), slice.end());
+    }
+
+    return matches;
+}
+
 template<typename DataType>
 class scan_engine_templated : public scan_engine
 {
     std::shared_ptr<custom_map<scan_result<DataType>>> _prev_scan_results;
 private:
 
-    std::function<bool(DataType, DataType, std::optional<DataType>)> compare(scan_type type);
+    __forceinline size_t stride() const { return _alignment ? _alignment : sizeof(DataType); }
 
+    // Both scans are instantiated per scan_predicate, see with_scan_predicate.
+    template<typename Predicate>
     std::shared_ptr<custom_map<scan_result<DataType>>> first_scan(std::queue<std::shared_ptr<memory_region>>& regions, scan_type type, std::atomic<size_t>& total_entries, const DataType& value1, std::optional<DataType> value2 = std::nullopt);
 
+    template<typename Predicate>
     std::shared_ptr<custom_map<scan_result<DataType>>> next_scan(std::queue<std::shared_ptr<memory_region>>& regions, scan_type type,
         std::shared_ptr<custom_map<scan_result<DataType>>> prev_scan, std::atomic<size_t>& total_entries, const DataType& value1, std::optional<DataType> value2);
 
 public:
-    scan_engine_templated(long process_id) : scan_engine(process_id) {}
+    scan_engine_templated(long process_id, std::shared_ptr<thread_pool> pool = nullptr) : scan_engine(process_id, std::move(pool)) {}
+    scan_engine_templated(std::shared_ptr<process_access> access, std::shared_ptr<thread_pool> pool = nullptr) : scan_engine(std::move(access), std::move(pool)) {}
     virtual ~scan_engine_templated() override = default;
 
     size_t scan(const std::pair<void*, void*>& range, scan_type type, const DataType& value1, std::optional<DataType> value2 = std::nullopt);
@@ -49,302 +384,308 @@ public:
 
 
 template<typename DataType>
-inline std::function<bool(DataType, DataType, std::optional<DataType>)> scan_engine_templated<DataType>::compare(scan_type type) {
-    std::function<bool(DataType, DataType, std::optional<DataType>)> cmp = nullptr;
-
-    switch (type) {
-    case scan_type::exact_value: {
-        cmp = [](DataType a, DataType b, std::optional<DataType> /*unused*/) {
-            return a == b;
-            };
-        break;
-    }
-    case scan_type::bigger_than: {
-        if constexpr (std::is_same_v<DataType, float>) {
-            cmp = [](float a, float b, std::optional<DataType> /*unused*/) {
-                return a > b + 0.0001f;
-                };
-        }
-        else if constexpr (std::is_same_v<DataType, double>) {
-            cmp = [](double a, double b, std::optional<DataType> /*unused*/) {
-                return a > b + 0.0000001;
-                };
-        }
-        else {
-            cmp = [](DataType a, DataType b, std::optional<DataType> /*unused*/) {
-                return a > b;
-                };
-        }
-        break;
-    }
-    case scan_type::smaller_than: {
-        if constexpr (std::is_same_v<DataType, float>) {
-            cmp = [](float a, float b, std::optional<DataType> /*unused*/) {
-                return a < b - 0.0001f;
-                };
-        }
-        else if constexpr (std::is_same_v<DataType, double>) {
-            cmp = [](double a, double b, std::optional<DataType> /*unused*/) {
-                return a < b - 0.0000001;
-                };
-        }
-        else {
-            cmp = [](DataType a, DataType b, std::optional<DataType> /*unused*/) {
-                return a < b;
-                };
-        }
-        break;
-    }
-    case scan_type::changed: {
-        cmp = [](DataType a, DataType b, std::optional<DataType> /*unused*/) {
-            return a != b;
-            };
-        break;
-    }
-    case scan_type::unchanged: {
-        cmp = [](DataType a, DataType b, std::optional<DataType> /*unused*/) {
-            return a == b;
-            };
-        break;
-    }
-    case scan_type::increased_by: {
-        cmp = [](DataType a, DataType b, std::optional<DataType> c) {
-            if (!c.has_value())
-                return false;
-            return a - b == *c;
-            };
-        break;
-    }
-    case scan_type::decreased_by: {
-        cmp = [](DataType a, DataType b, std::optional<DataType> c) {
-            if (!c.has_value())
-                return false;
-            return b - a == *c;
-            };
-        break;
-    }
-    case scan_type::value_between: {
-        cmp = [](DataType a, DataType b, std::optional<DataType> c) {
-            if (!c.has_value())
-                return false;
-            return a > b && a < *c;
-            };
-        break;
-    }
-    case scan_type::increased_value: {
-        cmp = [](DataType a, DataType b, std::optional<DataType> /*unused*/) {
-            return a > b;
-            };
-        break;
-    }
-    case scan_type::decreased_value: {
-        cmp = [](DataType a, DataType b, std::optional<DataType> /*unused*/) {
-            return a < b;
-            };
-        break;
-    }
+template<typename Predicate>
+inline std::shared_ptr<custom_map<scan_result<DataType>>> scan_engine_templated<DataType>::first_scan(std::queue<std::shared_ptr<memory_region>>& regions, scan_type type, std::atomic<size_t>& total_entries, const DataType& value1, std::optional<DataType> value2)
+{
+    // Matches of one slice of a region, produced by a single task.
+    struct slice_hits {
+        int32_t region_index{ 0 };
+        size_t begin_index{ 0 };
+        std::vector<scan_entry<DataType>> entries{};
+    };
 
-    default: {
-        break;
-    }
-    }
+    std::shared_ptr<custom_map<scan_result<DataType>>> results = std::make_shared<custom_map<scan_result<DataType>>>();
 
-    return cmp;
-}
+    // Only unknown_value takes a snapshot, the other scans without a predicate produce nothing.
+    bool snapshot = !Predicate::searchable && type == scan_type::unknown_value;
 
+    if ((!Predicate::searchable && !snapshot) || (Predicate::uses_extra && !value2))
+        return results;
 
-template<typename DataType>
-inline std::shared_ptr<custom_map<scan_result<DataType>>> scan_engine_templated<DataType>::first_scan(std::queue<std::shared_ptr<memory_region>>& regions, scan_type type, std::atomic<size_t>& total_entries, const DataType& value1, std::optional<DataType> value2)
-{
+    const DataType extra = value2.value_or(DataType{});
+    const compare_predicate<DataType> predicate = Predicate::vectorized(value1, extra);
 
-    std::shared_ptr<custom_map<scan_result<DataType>>> results = std::make_shared<custom_map<scan_result<DataType>>>();
-    int32_t i = 0;
+    // One slot per region, each written by exactly one task.
+    std::vector<std::shared_ptr<scan_result<DataType>>> slots(regions.size());
 
-    while (!regions.empty()) {
+    // Every worker appends to its own buffer, merged once all tasks are done.
+    std::vector<std::vector<slice_hits>> worker_hits(_pool->size() + 1);
 
-        auto current_region = regions.front();
+    const size_t stride = this->stride();
+    const bool use_kernel = predicate.kernel && scan_result<DataType>::kernel_stride(stride);
+    const size_t elements_per_slice = std::max<size_t>(1, SLICE_BYTES / stride);
 
-        regions.pop();
+    // Unpopulated pages hold zeros, they are not needed unless zero is a match.
+    const bool populated_only = !snapshot && !Predicate::match(DataType{}, value1, extra);
 
-        auto result = std::make_shared<scan_result<DataType>>(current_region, i);
-        auto success = false;
+    {
+        task_group group(*_pool);
+        int32_t i = 0;
 
-        std::function<bool(DataType, DataType, std::optional<DataType>)> cmp = compare(type);
+        while (!regions.empty()) {
 
-        //MULTITHREAD THIS
-        {
-            size_t bytes_read = 0;
+            auto batch = pop_batch(regions);
+            int32_t first_index = i;
+            i += static_cast<int32_t>(batch.size());
 
-            success = read_memory(current_region);
+            group.run([&, batch = std::move(batch), first_index]() mutable {
 
-            if (success) {
+                // Regions bigger than a read batch come alone, their chunks are searched as they are read.
+                if (!snapshot && batch.size() == 1 && should_stream(*batch[0], populated_only)) {
+                    auto result = make_scan_object<scan_result<DataType>>(batch[0], first_index);
+                    result->set_type(type);
+                    slots[first_index] = result;
 
-                success = false;
+                    auto total_elements = result->total_elements(stride);
 
-                if (type == scan_type::unknown_value) {
-                    success = current_region->dump(true);
-                }
+                    // slots keeps the result alive until the tasks are done.
+                    stream_region(group, batch[0], sizeof(DataType) - 1, populated_only,
+                        [&, result = result.get(), index = first_index, total_elements](const uint8_t* bytes, size_t offset, size_t size) {
+                            size_t begin = std::min(total_elements, (offset + stride - 1) / stride);
+                            size_t end = std::min(total_elements, (offset + size + stride - 1) / stride);
+                            slice_hits hits{ index, begin };
+
+                            if (use_kernel)
+                                result->search_kernel(predicate, bytes, offset, begin, end, hits.entries, stride);
+                            else
+                                result->search_range([&](DataType value) { return Predicate::match(value, value1, extra); }, bytes, offset, begin, end, hits.entries, stride);
 
-                if (cmp) {
-                    success = result->search_value(cmp, value1, value2);
+                            if (!hits.entries.empty())
+                                worker_hits[_pool->worker_index()].push_back(std::move(hits));
+                        });
 
-                    if (success)
-                        total_entries += result->elements().size();
+                    return;
                 }
-                if (success) {
+
+                read_memory(batch, populated_only);
+
+                for (size_t k = 0; k < batch.size(); k++) {
+                    auto& current_region = batch[k];
+                    int32_t index = first_index + static_cast<int32_t>(k);
+
+                    if (!current_region->is_valid())
+                        continue;
+
+                    if (_hash_pages)
+                        current_region->hash_pages();
+
+                    auto result = make_scan_object<scan_result<DataType>>(current_region, index);
                     result->set_type(type);
-                    results->insert(i, result);
-                }
-            }
 
+                    if (snapshot) {
+                        if (dump_snapshot(*current_region))
+                            slots[index] = result;
+                        continue;
+                    }
+
+                    slots[index] = result;
+
+                    auto total_elements = result->total_elements(stride);
+
+                    for (size_t begin = 0; begin < total_elements; begin += elements_per_slice) {
+                        size_t end = std::min(total_elements, begin + elements_per_slice);
+
+                        auto search_slice = [&, result = result.get(), index, begin, end]() {
+                            slice_hits hits{ index, begin };
+
+                            if (use_kernel)
+                                result->search_kernel(predicate, begin, end, hits.entries, stride);
+                            else
+                                result->search_range([&](DataType value) { return Predicate::match(value, value1, extra); }, begin, end, hits.entries, stride);
+
+                            if (!hits.entries.empty())
+                                worker_hits[_pool->worker_index()].push_back(std::move(hits));
+                        };
+
+                        // Small regions are searched in place, large ones are split so idle workers can steal slices.
+                        // Slices go ahead of the pending batches, the region they belong to is already held in memory.
+                        if (total_elements <= elements_per_slice)
+                            search_slice();
+                        else
+                            group.run(search_slice, 1);
+                    }
+                }
+            });
         }
-        i++;
+
+        group.wait();
+    }
+
+    // Merge the worker buffers, ordered by region index and slice so the output is deterministic.
+    std::vector<slice_hits*> ordered;
+
+    for (auto& hits : worker_hits) {
+        for (auto& slice : hits)
+            ordered.push_back(&slice);
     }
 
+    std::sort(ordered.begin(), ordered.end(), [](const slice_hits* lhs, const slice_hits* rhs) {
+        return lhs->region_index != rhs->region_index ? lhs->region_index < rhs->region_index : lhs->begin_index < rhs->begin_index;
+    });
+
+    for (auto slice : ordered)
+        slots[slice->region_index]->add_elements(slice->entries);
+
+    results->reserve_keys(slots.size());
+
+    for (size_t index = 0; index < slots.size(); index++) {
+        auto& result = slots[index];
 
+        if (!result)
+            continue;
+
+        if (!snapshot) {
+            if (result->count() == 0)
+                continue;
+
+            total_entries += result->count();
+            result->encode(stride);
+        }
+
+        results->insert(static_cast<int32_t>(index), result);
+    }
 
-    return std::move(results);
+    return results;
 }
 
 
 template<typename DataType>
+template<typename Predicate>
 std::shared_ptr<custom_map<scan_result<DataType>>> scan_engine_templated<DataType>::next_scan(std::queue<std::shared_ptr<memory_region>>& regions, scan_type type,
     std::shared_ptr<custom_map<scan_result<DataType>>> prev_scan, std::atomic<size_t>& total_entries, const DataType& value1, std::optional<DataType> value2)
 {
     std::shared_ptr<custom_map<scan_result<DataType>>> results = std::make_shared<custom_map<scan_result<DataType>>>();
-    std::array<deferred_processor, 8> processors;
-    int i = 0;
-    auto keys = prev_scan->keys();
 
-    for (auto key : keys) {
-        if (regions.empty())
-            break;
+    // Relative scans compare against the previous value and take value1 as their operand, absolute ones need value2 when they use it.
+    if (!Predicate::searchable || (!Predicate::relative && Predicate::uses_extra && !value2))
+        return results;
 
-        auto current_region = regions.front();
-        regions.pop();
+    const DataType extra = value2.value_or(DataType{});
 
-        // Advance prev_scan until we find a region that could overlap with current_region
-        if (prev_scan->at(key)->region_base() + prev_scan->at(key)->region_size() < current_region->base())
-        {
-            prev_scan->erase(key); // Remove regions that are completely before current_region
-            continue;
-        }
+    diff_predicate<DataType> diff;
 
-        // Check if the remaining region in prev_scan overlaps with current_region
-        if (prev_scan->at(key)->region_base() < current_region->base() + current_region->size()) {
-            auto old_scan = prev_scan->at(key);
+    if constexpr (Predicate::relative)
+        diff = Predicate::diff(value1);
 
-            prev_scan->erase(key);
+    const size_t stride = this->stride();
 
-            if (!old_scan)
-                continue;
+    region_index current(regions);
 
-            processors[i % 8].add_operation([this, old_scan, current_region, &results, &total_entries, type, value1, value2] {
+    // Every position gets its slot before the tasks fill them.
+    results->reserve_keys(current.size());
 
-                size_t bytes_read = 0;
+    // Every previous result is paired with the current regions it overlaps, wherever the target mapped or unmapped memory.
+    // prev_scan owns the previous results for the whole scan, they are paired by plain pointer.
+    std::vector<std::vector<scan_result<DataType>*>> previous(current.size());
 
-                auto success = read_memory(current_region);
+    prev_scan->for_each([&](int32_t, const std::shared_ptr<scan_result<DataType>>& old_scan) {
+        if (!old_scan)
+            return;
 
-                if (!success)
-                    return;
+        auto [first, last] = current.overlapping(old_scan->region_base(), old_scan->region_base() + old_scan->region_size());
 
-                auto old_scan_type = old_scan->type();
+        for (size_t position = first; position < last; position++)
+            previous[position].push_back(old_scan.get());
 
-                std::span<scan_entry<DataType>> elements = std::span<scan_entry<DataType>>();
+        // Read by the tasks of several positions.
+        if (last - first > 1)
+            old_scan->associated_region()->map_snapshot();
+    });
 
-                auto prev_region = old_scan->associated_region();
+    // Largest positions first. Those above SLICE_BYTES also go ahead of the pending small ones, their windows follow them.
+    std::vector<std::pair<size_t, size_t>> order;
 
-                size_t total_elements{ 0 };
+    for (size_t position = 0; position < current.size(); position++) {
+        if (!previous[position].empty())
+            order.push_back({ rescan_work<DataType>(*current[position], previous[position]), position });
+    }
 
-                if (!prev_region)
-                    return;
+    std::sort(order.begin(), order.end(), [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first; });
 
-                if (old_scan_type == scan_type::unknown_value) {
-                    //we can't access the elements since we didnt create the elements in the first scan
-                    total_elements = prev_region->size() / sizeof(DataType);
-                }
-                else {
-                    elements = old_scan->elements();
-                    total_elements = elements.size();
-                }
+    // Results of the windows of split positions, concatenated in address order once all tasks are done.
+    std::vector<std::vector<std::shared_ptr<scan_result<DataType>>>> windows(current.size());
 
+    task_group group(*_pool);
 
-                auto result = std::make_shared<scan_result<DataType>>(current_region, old_scan->index());
+    for (auto [work, position] : order) {
+        bool split = work > SLICE_BYTES;
 
-                for (size_t i = 0; i < total_elements; i++) {
+        group.run([this, &group, &current, &previous, &windows, position, split, &results, &total_entries, type, value1, extra, diff, stride] {
+            auto& current_region = current[position];
+            auto& old_scans = previous[position];
 
-                    success = false;
+            std::vector<std::pair<size_t, size_t>> runs;
+            bool sparse = true;
 
-                    DataType* old_value = nullptr;
+            for (auto& old_scan : old_scans)
+                sparse = sparse && candidate_pages(*current_region, *old_scan, runs);
 
-                    if (old_scan_type == scan_type::unknown_value) {
-                        old_value = prev_region->at_index<DataType>(i);
+            auto success = sparse ? read_candidates(current_region, runs) : read_changed(current_region, *old_scans.front()->associated_region());
 
-                        if (!old_value)
-                            continue;
-                    }
+            if (!success)
+                return;
 
-                    scan_entry<DataType> old_elem = (old_scan_type == scan_type::unknown_value) ? scan_entry<DataType>{*old_value, prev_region->base() + i * sizeof(DataType)} : elements[i];
+            if (_hash_pages)
+                current_region->hash_pages();
 
-                    auto new_value = current_region->at_address<DataType>(old_elem.address);
+            if (split) {
+                size_t count = (current_region->size() + SLICE_BYTES - 1) / SLICE_BYTES;
+                windows[position].resize(count);
 
-                    if (!new_value)
-                        continue;
+                // The windows read the previous snapshots concurrently.
+                for (auto& old_scan : old_scans)
+                    old_scan->associated_region()->map_snapshot();
 
-                    std::function<bool(DataType, DataType, std::optional<DataType>)> cmp = compare(type);
+                for (size_t window = 0; window < count; window++) {
+                    group.run([this, &current, &previous, &windows, position, window, &total_entries, type, value1, extra, diff, stride] {
+                        auto& current_region = current[position];
+                        auto part = make_scan_object<scan_result<DataType>>(current_region, position);
+                        part->set_type(type);
 
-                    if (!cmp)
-                        continue;
-                    //we must filter for allowed scan types
+                        uint64_t begin = current_region->base() + window * SLICE_BYTES;
+                        uint64_t end = begin + SLICE_BYTES;
 
-                    switch (type) {
-                    case scan_type::exact_value: {
-                        if (cmp(*new_value, value1, value2)) {
+                        for (auto& old_scan : previous[position])
+                            total_entries += part->template rescan<Predicate>(*old_scan, value1, extra, diff, stride, begin, end);
 
-                            success = true;
-                        }
-                        break;
-                    }
-                    case scan_type::increased_value:
-                    case scan_type::decreased_value:
-                    case scan_type::changed:
-                    case scan_type::unchanged:
-                    case scan_type::decreased_by:
-                    case scan_type::increased_by: {
-                        if (cmp(*new_value, old_elem.value, value1)) {
-
-                            success = true;
-                        }
-                        break;
-                    }
-                    case scan_type::value_between: {
-                    case scan_type::smaller_than:
-                    case scan_type::bigger_than: {
-                        if (cmp(*new_value, value1, value2)) {
-
-                            success = true;
-                        }
-                        break;
-                    }
-                    default:
-                        break;
-                    }
-                    }
-
-                    if (success) {
-                        total_entries++;
-                        result->add_element({ *new_value ,old_elem.address });
-                        result->set_type(type);
-                    }
+                        windows[position][window] = part;
+                    }, 1);
                 }
 
-                if (result->elements().size() > 0) {
-                    results->insert(old_scan->index(), result);
-                }
-                   
-                });
-           
+                return;
+            }
+
+            auto result = make_scan_object<scan_result<DataType>>(current_region, position);
+            result->set_type(type);
+
+            // Previous results are in address order, so are the hits appended from each of them.
+            for (auto& old_scan : old_scans)
+                total_entries += result->template rescan<Predicate>(*old_scan, value1, extra, diff, stride);
+
+            if (result->count() > 0) {
+                result->encode(stride);
+                results->insert(static_cast<int32_t>(position), result);
+            }
+        }, split ? 1 : 0);
+    }
 
+    group.wait();
+
+    for (size_t position = 0; position < current.size(); position++) {
+        if (windows[position].empty())
+            continue;
+
+        auto result = make_scan_object<scan_result<DataType>>(current[position], position);
+        result->set_type(type);
+
+        for (auto& part : windows[position]) {
+            if (part)
+                result->add_elements(*part);
+        }
+
+        if (result->count() > 0) {
+            result->encode(stride);
+            results->insert(static_cast<int32_t>(position), result);
         }
     }
 
@@ -358,16 +699,23 @@ std::shared_ptr<custom_map<scan_result<DataType>>> scan_engine_templated<DataTyp
 template<typename DataType>
 inline size_t scan_engine_templated<DataType>::scan(const std::pair<void*, void*>& range, scan_type type, const DataType& value1, std::optional<DataType> value2)
 {
-    auto regions = get_regions(range, PAGE_READWRITE | PAGE_WRITECOPY);
+    auto regions = get_regions(range, protection_write);
+    track_writes(regions);
 
     std::atomic<size_t> total_entries = 0;
-    if (_current_scan == 0) {
-        _prev_scan_results = first_scan(regions, type, total_entries, value1, value2);
-        _current_scan = 1;
-    }
-    else {
-        _prev_scan_results = next_scan(regions, type, _prev_scan_results, total_entries, value1, value2);
-    }
+
+    // The scan type is resolved once here, the loops below are instantiated per predicate.
+    with_scan_predicate<DataType>(type, [&]<typename Predicate>() {
+        if (_current_scan == 0) {
+            _prev_scan_results = first_scan<Predicate>(regions, type, total_entries, value1, value2);
+            _current_scan = 1;
+        }
+        else {
+            _prev_scan_results = next_scan<Predicate>(regions, type, _prev_scan_results, total_entries, value1, value2);
+        }
+    });
+
+    retire_idle_regions();
 
     return total_entries;
 }
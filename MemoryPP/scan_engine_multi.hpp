@@ -0,0 +1,573 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <tuple>
+#include "scan_engine.hpp"
+
+// Scans several value types over the same memory. Every region is read once per scan and all the
+// types are evaluated over the same buffer, the results are kept apart per type.
+template<typename... Types>
+class scan_engine_multi : public scan_engine
+{
+    template<typename T>
+    using result_map = std::shared_ptr<custom_map<scan_result<T>>>;
+
+    std::tuple<result_map<Types>...> _prev_scan_results;
+
+    // Operands of a scan converted to one type.
+    template<typename T>
+    struct operands {
+        bool enabled{ false };
+        T value1{};
+        std::optional<T> value2;
+    };
+
+    using operand_set = std::tuple<operands<Types>...>;
+
+    // Work of one region during a first scan. Slices write their own part, merged in order once all are done.
+    struct region_job {
+        std::tuple<std::shared_ptr<scan_result<Types>>...> results;
+        std::tuple<std::vector<std::vector<scan_entry<Types>>>...> parts;
+    };
+
+    // A region of a next scan with the previous results of every type that overlap it.
+    // The previous results are owned by _prev_scan_results until the scan is done.
+    struct rescan_job {
+        std::shared_ptr<memory_region> region;
+        std::tuple<std::vector<scan_result<Types>*>...> previous;
+        size_t work{ 0 };   // Bytes of values compared, see rescan_work.
+
+        // Results of the windows of a job above SLICE_BYTES, concatenated in address order once all tasks are done.
+        std::tuple<std::vector<std::shared_ptr<scan_result<Types>>>...> windows;
+    };
+
+    template<typename F>
+    static __forceinline void for_each_type(F&& func) { (func.template operator()<Types>(), ...); }
+
+    template<typename T>
+    __forceinline size_t stride() const { return _alignment ? _alignment : sizeof(T); }
+
+    // Converts value to T, false when T can't represent it exactly.
+    template<typename T>
+    static bool convert_operand(double value, T& out);
+
+    operand_set make_operands(double value1, std::optional<double> value2);
+
+    void first_scan(std::queue<std::shared_ptr<memory_region>>& regions, scan_type type, const operand_set& ops, std::atomic<size_t>& total_entries);
+
+    void next_scan(std::queue<std::shared_ptr<memory_region>>& regions, scan_type type, const operand_set& ops, std::atomic<size_t>& total_entries);
+
+public:
+    scan_engine_multi(long process_id, std::shared_ptr<thread_pool> pool = nullptr) : scan_engine(process_id, std::move(pool)) {}
+    scan_engine_multi(std::shared_ptr<process_access> access, std::shared_ptr<thread_pool> pool = nullptr) : scan_engine(std::move(access), std::move(pool)) {}
+    virtual ~scan_engine_multi() override = default;
+
+    // Operands are converted to every type, a type that can't represent them exactly sits the scan out
+    // and keeps no results. Returns the entries found over all types.
+    size_t scan(const std::pair<void*, void*>& range, scan_type type, double value1, std::optional<double> value2 = std::nullopt);
+
+    template<typename T>
+    __forceinline result_map<T> get_results() { return std::get<result_map<T>>(_prev_scan_results); }
+
+    // Number of entries kept for T.
+    template<typename T>
+    size_t count();
+};
+
+// The numeric types an exploratory scan usually has to try.
+using scan_engine_numeric = scan_engine_multi<int16_t, int32_t, int64_t, float, double>;
+
+
+template<typename... Types>
+template<typename T>
+inline bool scan_engine_multi<Types...>::convert_operand(double value, T& out)
+{
+    if constexpr (std::is_floating_point_v<T>) {
+        out = static_cast<T>(value);
+        return true;
+    }
+    else {
+        if (std::trunc(value) != value)
+            return false;
+
+        // max + 1 is a power of two, exact as a double unlike max itself.
+        const double low = static_cast<double>(std::numeric_limits<T>::min());
+        const double high = static_cast<double>(std::numeric_limits<T>::max() / 2 + 1) * 2.0;
+
+        if (value < low || value >= high)
+            return false;
+
+        out = static_cast<T>(value);
+        return true;
+    }
+}
+
+template<typename... Types>
+inline typename scan_engine_multi<Types...>::operand_set scan_engine_multi<Types...>::make_operands(double value1, std::optional<double> value2)
+{
+    operand_set ops;
+
+    for_each_type([&]<typename T>() {
+        auto& op = std::get<operands<T>>(ops);
+        op.enabled = convert_operand(value1, op.value1);
+
+        if (value2) {
+            T converted{};
+            if (convert_operand(*value2, converted))
+                op.value2 = converted;
+            else
+                op.enabled = false;
+        }
+
+        // Only the types the first scan ran for have results to rescan.
+        if (_current_scan != 0 && !std::get<result_map<T>>(_prev_scan_results))
+            op.enabled = false;
+    });
+
+    return ops;
+}
+
+template<typename... Types>
+inline void scan_engine_multi<Types...>::first_scan(std::queue<std::shared_ptr<memory_region>>& regions, scan_type type, const operand_set& ops, std::atomic<size_t>& total_entries)
+{
+    bool snapshot = type == scan_type::unknown_value;
+
+    // Unpopulated pages hold zeros, they are not needed unless zero is a match for one of the types.
+    bool populated_only = !snapshot;
+
+    for_each_type([&]<typename T>() {
+        auto& op = std::get<operands<T>>(ops);
+
+        if (!op.enabled)
+            return;
+
+        with_scan_predicate<T>(type, [&]<typename Predicate>() {
+            if constexpr (Predicate::searchable)
+                populated_only = populated_only && !Predicate::match(T{}, op.value1, op.value2.value_or(T{}));
+        });
+    });
+
+    std::vector<region_job> jobs(regions.size());
+
+    // Searches every type over one slice of a job. bytes holds the slice when the region is streamed,
+    // otherwise it is null and the slice is taken from the region data.
+    auto search_slice = [&](region_job& job, size_t slice, const uint8_t* bytes) {
+        for_each_type([&]<typename T>() {
+            auto& result = std::get<std::shared_ptr<scan_result<T>>>(job.results);
+
+            if (!result)
+                return;
+
+            auto& op = std::get<operands<T>>(ops);
+            const size_t stride = this->template stride<T>();
+            const size_t total = result->total_elements(stride);
+            size_t begin = std::min(total, (slice * SLICE_BYTES + stride - 1) / stride);
+            size_t end = std::min(total, ((slice + 1) * SLICE_BYTES + stride - 1) / stride);
+            auto& out = std::get<std::vector<std::vector<scan_entry<T>>>>(job.parts)[slice];
+
+            if (begin >= end)
+                return;
+
+            with_scan_predicate<T>(type, [&]<typename Predicate>() {
+                if constexpr (Predicate::searchable) {
+                    if (Predicate::uses_extra && !op.value2)
+                        return;
+
+                    const T extra = op.value2.value_or(T{});
+                    auto predicate = Predicate::vectorized(op.value1, extra);
+                    auto match = [&](T value) { return Predicate::match(value, op.value1, extra); };
+
+                    if (predicate.kernel && scan_result<T>::kernel_stride(stride)) {
+                        if (bytes)
+                            result->search_kernel(predicate, bytes, slice * SLICE_BYTES, begin, end, out, stride);
+                        else
+                            result->search_kernel(predicate, begin, end, out, stride);
+                    }
+                    else {
+                        if (bytes)
+                            result->search_range(match, bytes, slice * SLICE_BYTES, begin, end, out, stride);
+                        else
+                            result->search_range(match, begin, end, out, stride);
+                    }
+                }
+            });
+        });
+    };
+
+    // Values read past a streamed chunk, the widest type starting on its last byte.
+    size_t overlap = 0;
+    for_each_type([&]<typename T>() { overlap = std::max(overlap, sizeof(T) - 1); });
+
+    {
+        task_group group(*_pool);
+        size_t i = 0;
+
+        while (!regions.empty()) {
+
+            auto batch = pop_batch(regions);
+            size_t first_index = i;
+            i += batch.size();
+
+            group.run([&, batch = std::move(batch), first_index]() mutable {
+                // Slices are cut in bytes so every type splits the region at the same places.
+                auto create_results = [&](std::shared_ptr<memory_region>& current_region, region_job& job, size_t index) {
+                    size_t slices = (current_region->size() + SLICE_BYTES - 1) / SLICE_BYTES;
+
+                    for_each_type([&]<typename T>() {
+                        if (!std::get<operands<T>>(ops).enabled)
+                            return;
+
+                        auto result = make_scan_object<scan_result<T>>(current_region, index);
+                        result->set_type(type);
+                        std::get<std::shared_ptr<scan_result<T>>>(job.results) = result;
+
+                        if (!snapshot)
+                            std::get<std::vector<std::vector<scan_entry<T>>>>(job.parts).resize(slices);
+                    });
+
+                    return slices;
+                };
+
+                // Regions bigger than a read batch come alone, their chunks are searched as they are read.
+                if (!snapshot && batch.size() == 1 && should_stream(*batch[0], populated_only)) {
+                    auto& job = jobs[first_index];
+                    create_results(batch[0], job, first_index);
+
+                    stream_region(group, batch[0], overlap, populated_only, [&, &job = job](const uint8_t* bytes, size_t offset, size_t) {
+                        search_slice(job, offset / SLICE_BYTES, bytes);
+                    });
+
+                    return;
+                }
+
+                // One read serves every type.
+                read_memory(batch, populated_only);
+
+                for (size_t k = 0; k < batch.size(); k++) {
+                    auto& current_region = batch[k];
+                    auto& job = jobs[first_index + k];
+
+                    if (!current_region->is_valid())
+                        continue;
+
+                    if (_hash_pages)
+                        current_region->hash_pages();
+
+                    if (snapshot && !dump_snapshot(*current_region))
+                        continue;
+
+                    size_t slices = create_results(current_region, job, first_index + k);
+
+                    if (snapshot)
+                        continue;
+
+                    for (size_t slice = 0; slice < slices; slice++) {
+                        if (slices == 1)
+                            search_slice(job, slice, nullptr);
+                        else
+                            group.run([&, &job = job, slice]() { search_slice(job, slice, nullptr); }, 1);
+                    }
+                }
+            });
+        }
+
+        group.wait();
+    }
+
+    for_each_type([&]<typename T>() {
+        if (!std::get<operands<T>>(ops).enabled) {
+            std::get<result_map<T>>(_prev_scan_results) = nullptr;
+            return;
+        }
+
+        auto results = std::make_shared<custom_map<scan_result<T>>>(jobs.size());
+
+        for (size_t index = 0; index < jobs.size(); index++) {
+            auto& result = std::get<std::shared_ptr<scan_result<T>>>(jobs[index].results);
+
+            if (!result)
+                continue;
+
+            if (!snapshot) {
+                for (auto& part : std::get<std::vector<std::vector<scan_entry<T>>>>(jobs[index].parts))
+                    result->add_elements(part);
+
+                if (result->count() == 0)
+                    continue;
+
+                total_entries += result->count();
+                result->encode(this->template stride<T>());
+            }
+
+            results->insert(static_cast<int32_t>(index), result);
+        }
+
+        std::get<result_map<T>>(_prev_scan_results) = results;
+    });
+}
+
+template<typename... Types>
+inline void scan_engine_multi<Types...>::next_scan(std::queue<std::shared_ptr<memory_region>>& regions, scan_type type, const operand_set& ops, std::atomic<size_t>& total_entries)
+{
+    region_index current(regions);
+    std::vector<rescan_job> jobs(current.size());
+
+    for (size_t position = 0; position < current.size(); position++)
+        jobs[position].region = current[position];
+
+    // Every previous result is paired with the current regions it overlaps, wherever the target mapped or unmapped memory.
+    for_each_type([&]<typename T>() {
+        auto& previous = std::get<result_map<T>>(_prev_scan_results);
+
+        if (!previous || !std::get<operands<T>>(ops).enabled)
+            return;
+
+        previous->for_each([&](int32_t, const std::shared_ptr<scan_result<T>>& old_scan) {
+            auto [first, last] = current.overlapping(old_scan->region_base(), old_scan->region_base() + old_scan->region_size());
+
+            for (size_t position = first; position < last; position++)
+                std::get<std::vector<scan_result<T>*>>(jobs[position].previous).push_back(old_scan.get());
+
+            // Read by the tasks of several jobs.
+            if (last - first > 1)
+                old_scan->associated_region()->map_snapshot();
+        });
+    });
+
+    std::erase_if(jobs, [](rescan_job& job) {
+        bool any = false;
+        std::apply([&](auto&... previous) { any = (!previous.empty() || ...); }, job.previous);
+        return !any;
+    });
+
+    std::tuple<std::vector<std::shared_ptr<scan_result<Types>>>...> slots;
+
+    std::apply([&](auto&... slot) { (slot.resize(jobs.size()), ...); }, slots);
+
+    for (auto& job : jobs) {
+        for_each_type([&]<typename T>() {
+            job.work += rescan_work<T>(*job.region, std::get<std::vector<scan_result<T>*>>(job.previous));
+        });
+
+        job.work = std::min(job.work, job.region->size());
+    }
+
+    // Rescans the previous results of every type of jobs[k] over the elements starting in [begin, end).
+    // Whole jobs store their results in the slots, the windows of split ones in their job.
+    auto rescan_job_types = [&](size_t k, uint64_t begin, uint64_t end, size_t window) {
+        auto& job = jobs[k];
+
+        for_each_type([&]<typename T>() {
+            auto& op = std::get<operands<T>>(ops);
+            auto& previous = std::get<std::vector<scan_result<T>*>>(job.previous);
+
+            if (previous.empty())
+                return;
+
+            auto result = make_scan_object<scan_result<T>>(job.region, k);
+            result->set_type(type);
+
+            with_scan_predicate<T>(type, [&]<typename Predicate>() {
+                if constexpr (Predicate::searchable) {
+                    if (!Predicate::relative && Predicate::uses_extra && !op.value2)
+                        return;
+
+                    const T extra = op.value2.value_or(T{});
+                    diff_predicate<T> diff;
+
+                    if constexpr (Predicate::relative)
+                        diff = Predicate::diff(op.value1);
+
+                    for (auto old_scan : previous)
+                        total_entries += result->template rescan<Predicate>(*old_scan, op.value1, extra, diff, this->template stride<T>(), begin, end);
+                }
+            });
+
+            if (window != SIZE_MAX) {
+                std::get<std::vector<std::shared_ptr<scan_result<T>>>>(job.windows)[window] = result;
+                return;
+            }
+
+            result->encode(this->template stride<T>());
+
+            if (result->count() > 0)
+                std::get<std::vector<std::shared_ptr<scan_result<T>>>>(slots)[k] = result;
+        });
+    };
+
+    // Consecutive small jobs share a batch, same batching as pop_batch. Jobs above SLICE_BYTES get one of their own.
+    // Batches are submitted largest first, the split ones ahead of the pending small ones so their windows follow them.
+    std::vector<std::tuple<size_t, size_t, size_t>> batches;   // (work, first, last)
+    size_t i = 0;
+
+    while (i < jobs.size()) {
+        size_t first_index = i;
+        size_t batch_bytes = 0;
+        size_t work = 0;
+
+        if (jobs[i].work > SLICE_BYTES) {
+            batches.push_back({ jobs[i].work, i, i + 1 });
+            i++;
+            continue;
+        }
+
+        while (i < jobs.size() && jobs[i].work <= SLICE_BYTES && (i == first_index || batch_bytes + jobs[i].region->size() <= READ_BATCH_BYTES)) {
+            batch_bytes += jobs[i].region->size();
+            work += jobs[i++].work;
+        }
+
+        batches.push_back({ work, first_index, i });
+    }
+
+    std::stable_sort(batches.begin(), batches.end(), [](const auto& lhs, const auto& rhs) { return std::get<0>(lhs) > std::get<0>(rhs); });
+
+    {
+        task_group group(*_pool);
+
+        for (auto [work, first_index, last_index] : batches) {
+            bool split = last_index - first_index == 1 && jobs[first_index].work > SLICE_BYTES;
+
+            group.run([&, first_index, last_index]() {
+                std::vector<std::shared_ptr<memory_region>> batch;
+
+                // Regions whose previous hits all sit in a few pages only read those, the others are read whole in one batch.
+                for (size_t k = first_index; k < last_index; k++) {
+                    std::vector<std::pair<size_t, size_t>> runs;
+                    memory_region* reference = nullptr;
+                    bool sparse = true;
+
+                    for_each_type([&]<typename T>() {
+                        for (auto old_scan : std::get<std::vector<scan_result<T>*>>(jobs[k].previous)) {
+                            sparse = sparse && candidate_pages(*jobs[k].region, *old_scan, runs);
+
+                            if (!reference)
+                                reference = old_scan->associated_region().get();
+                        }
+                    });
+
+                    if (sparse)
+                        read_candidates(jobs[k].region, runs);
+                    else if (jobs[k].region->has_written_pages() && reference)
+                        read_changed(jobs[k].region, *reference);
+                    else
+                        batch.push_back(jobs[k].region);
+                }
+
+                read_memory(batch);
+
+                for (size_t k = first_index; k < last_index; k++) {
+                    auto& job = jobs[k];
+
+                    if (!job.region->is_valid())
+                        continue;
+
+                    if (_hash_pages)
+                        job.region->hash_pages();
+
+                    if (job.work <= SLICE_BYTES) {
+                        rescan_job_types(k, 0, UINT64_MAX, SIZE_MAX);
+                        continue;
+                    }
+
+                    size_t count = (job.region->size() + SLICE_BYTES - 1) / SLICE_BYTES;
+                    std::apply([&](auto&... windows) { (windows.resize(count), ...); }, job.windows);
+
+                    // The windows read the previous snapshots concurrently.
+                    for_each_type([&]<typename T>() {
+                        for (auto old_scan : std::get<std::vector<scan_result<T>*>>(job.previous))
+                            old_scan->associated_region()->map_snapshot();
+                    });
+
+                    for (size_t window = 0; window < count; window++) {
+                        group.run([&, k, window]() {
+                            uint64_t begin = jobs[k].region->base() + window * SLICE_BYTES;
+                            rescan_job_types(k, begin, begin + SLICE_BYTES, window);
+                        }, 1);
+                    }
+                }
+            }, split ? 1 : 0);
+        }
+
+        group.wait();
+    }
+
+    for (size_t k = 0; k < jobs.size(); k++) {
+        for_each_type([&]<typename T>() {
+            auto& parts = std::get<std::vector<std::shared_ptr<scan_result<T>>>>(jobs[k].windows);
+
+            if (parts.empty())
+                return;
+
+            auto result = make_scan_object<scan_result<T>>(jobs[k].region, k);
+            result->set_type(type);
+
+            for (auto& part : parts) {
+                if (part)
+                    result->add_elements(*part);
+            }
+
+            result->encode(this->template stride<T>());
+
+            if (result->count() > 0)
+                std::get<std::vector<std::shared_ptr<scan_result<T>>>>(slots)[k] = result;
+        });
+    }
+
+    for_each_type([&]<typename T>() {
+        if (!std::get<operands<T>>(ops).enabled) {
+            std::get<result_map<T>>(_prev_scan_results) = nullptr;
+            return;
+        }
+
+        auto& slot = std::get<std::vector<std::shared_ptr<scan_result<T>>>>(slots);
+        auto results = std::make_shared<custom_map<scan_result<T>>>(slot.size());
+
+        for (size_t index = 0; index < slot.size(); index++) {
+            if (slot[index])
+                results->insert(static_cast<int32_t>(index), slot[index]);
+        }
+
+        std::get<result_map<T>>(_prev_scan_results) = results;
+    });
+}
+
+template<typename... Types>
+inline size_t scan_engine_multi<Types...>::scan(const std::pair<void*, void*>& range, scan_type type, double value1, std::optional<double> value2)
+{
+    auto regions = get_regions(range, protection_write);
+    track_writes(regions);
+
+    auto ops = make_operands(value1, value2);
+
+    std::atomic<size_t> total_entries = 0;
+
+    if (_current_scan == 0) {
+        first_scan(regions, type, ops, total_entries);
+        _current_scan = 1;
+    }
+    else {
+        next_scan(regions, type, ops, total_entries);
+    }
+
+    retire_idle_regions();
+
+    return total_entries;
+}
+
+template<typename... Types>
+template<typename T>
+inline size_t scan_engine_multi<Types...>::count()
+{
+    auto results = get_results<T>();
+    size_t total = 0;
+
+    if (!results)
+        return 0;
+
+    results->for_each([&](int32_t, const std::shared_ptr<scan_result<T>>& result) {
+        total += result->count();
+    });
+
+    return total;
+}
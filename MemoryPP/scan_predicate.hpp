@@ -0,0 +1,214 @@
+#pragma once
+#include <type_traits>
+#include "scan_result/scan_result.hpp"
+#include "simd/compare_kernels.hpp"
+
+// Compile time form of a scan kind. The scan loops are instantiated once per predicate,
+// so match() is inlined into them instead of being called through a std::function.
+//
+// match(a, b, c) mirrors the operands of the old comparator:
+//   first scan               a = value, b = value1, c = value2
+//   next scan, absolute      a = value, b = value1, c = value2
+//   next scan, relative      a = value, b = previous value, c = value1
+struct scan_predicate_base {
+    // Compares against the previous value of the element in a next scan.
+    static constexpr bool relative = false;
+    // Reads c, the scan matches nothing when it is missing.
+    static constexpr bool uses_extra = false;
+    // False for the scans that only take a snapshot.
+    static constexpr bool searchable = true;
+};
+
+template <scan_type Type, typename DataType>
+struct scan_predicate;
+
+template <typename DataType>
+struct scan_predicate<scan_type::unknown_value, DataType> : scan_predicate_base {
+    static constexpr bool searchable = false;
+
+    static __forceinline bool match(DataType, DataType, DataType) { return false; }
+    static compare_predicate<DataType> vectorized(DataType, DataType) { return {}; }
+};
+
+template <typename DataType>
+struct scan_predicate<scan_type::exact_value, DataType> : scan_predicate_base {
+    static __forceinline bool match(DataType a, DataType b, DataType) { return a == b; }
+
+    static compare_predicate<DataType> vectorized(DataType b, DataType) {
+        if constexpr (has_compare_kernels<DataType>)
+            return { get_compare_kernel<DataType>(compare_op::equal), b };
+        else
+            return {};
+    }
+};
+
+template <typename DataType>
+struct scan_predicate<scan_type::bigger_than, DataType> : scan_predicate_base {
+    static __forceinline DataType threshold(DataType b) {
+        if constexpr (std::is_same_v<DataType, float>)
+            return b + 0.0001f;
+        else if constexpr (std::is_same_v<DataType, double>)
+            return b + 0.0000001;
+        else
+            return b;
+    }
+
+    static __forceinline bool match(DataType a, DataType b, DataType) { return a > threshold(b); }
+
+    static compare_predicate<DataType> vectorized(DataType b, DataType) {
+        if constexpr (has_compare_kernels<DataType>)
+            return { get_compare_kernel<DataType>(compare_op::greater), threshold(b) };
+        else
+            return {};
+    }
+};
+
+template <typename DataType>
+struct scan_predicate<scan_type::smaller_than, DataType> : scan_predicate_base {
+    static __forceinline DataType threshold(DataType b) {
+        if constexpr (std::is_same_v<DataType, float>)
+            return b - 0.0001f;
+        else if constexpr (std::is_same_v<DataType, double>)
+            return b - 0.0000001;
+        else
+            return b;
+    }
+
+    static __forceinline bool match(DataType a, DataType b, DataType) { return a < threshold(b); }
+
+    static compare_predicate<DataType> vectorized(DataType b, DataType) {
+        if constexpr (has_compare_kernels<DataType>)
+            return { get_compare_kernel<DataType>(compare_op::less), threshold(b) };
+        else
+            return {};
+    }
+};
+
+template <typename DataType>
+struct scan_predicate<scan_type::value_between, DataType> : scan_predicate_base {
+    static constexpr bool uses_extra = true;
+
+    static __forceinline bool match(DataType a, DataType b, DataType c) { return a > b && a < c; }
+
+    static compare_predicate<DataType> vectorized(DataType b, DataType c) {
+        if constexpr (has_compare_kernels<DataType>)
+            return { get_compare_kernel<DataType>(compare_op::between), b, c };
+        else
+            return {};
+    }
+};
+
+// Relative scans have no kernel in the first scan, where b is value1 instead of a previous value.
+// diff(c) returns the kernel comparing a snapshot with the new values in a next scan.
+
+template <typename DataType>
+struct scan_predicate<scan_type::changed, DataType> : scan_predicate_base {
+    static constexpr bool relative = true;
+
+    static __forceinline bool match(DataType a, DataType b, DataType) { return a != b; }
+    static compare_predicate<DataType> vectorized(DataType, DataType) { return {}; }
+
+    static diff_predicate<DataType> diff(DataType c) {
+        if constexpr (has_compare_kernels<DataType>)
+            return { get_diff_kernel<DataType>(diff_op::changed), c };
+        else
+            return {};
+    }
+};
+
+template <typename DataType>
+struct scan_predicate<scan_type::unchanged, DataType> : scan_predicate_base {
+    static constexpr bool relative = true;
+
+    static __forceinline bool match(DataType a, DataType b, DataType) { return a == b; }
+    static compare_predicate<DataType> vectorized(DataType, DataType) { return {}; }
+
+    static diff_predicate<DataType> diff(DataType c) {
+        if constexpr (has_compare_kernels<DataType>)
+            return { get_diff_kernel<DataType>(diff_op::unchanged), c };
+        else
+            return {};
+    }
+};
+
+template <typename DataType>
+struct scan_predicate<scan_type::increased_value, DataType> : scan_predicate_base {
+    static constexpr bool relative = true;
+
+    static __forceinline bool match(DataType a, DataType b, DataType) { return a > b; }
+    static compare_predicate<DataType> vectorized(DataType, DataType) { return {}; }
+
+    static diff_predicate<DataType> diff(DataType c) {
+        if constexpr (has_compare_kernels<DataType>)
+            return { get_diff_kernel<DataType>(diff_op::increased), c };
+        else
+            return {};
+    }
+};
+
+template <typename DataType>
+struct scan_predicate<scan_type::decreased_value, DataType> : scan_predicate_base {
+    static constexpr bool relative = true;
+
+    static __forceinline bool match(DataType a, DataType b, DataType) { return a < b; }
+    static compare_predicate<DataType> vectorized(DataType, DataType) { return {}; }
+
+    static diff_predicate<DataType> diff(DataType c) {
+        if constexpr (has_compare_kernels<DataType>)
+            return { get_diff_kernel<DataType>(diff_op::decreased), c };
+        else
+            return {};
+    }
+};
+
+template <typename DataType>
+struct scan_predicate<scan_type::increased_by, DataType> : scan_predicate_base {
+    static constexpr bool relative = true;
+    static constexpr bool uses_extra = true;
+
+    // The difference wraps in DataType, as it does in the diff kernels.
+    static __forceinline bool match(DataType a, DataType b, DataType c) { return static_cast<DataType>(a - b) == c; }
+    static compare_predicate<DataType> vectorized(DataType, DataType) { return {}; }
+
+    static diff_predicate<DataType> diff(DataType c) {
+        if constexpr (has_compare_kernels<DataType>)
+            return { get_diff_kernel<DataType>(diff_op::increased_by), c };
+        else
+            return {};
+    }
+};
+
+template <typename DataType>
+struct scan_predicate<scan_type::decreased_by, DataType> : scan_predicate_base {
+    static constexpr bool relative = true;
+    static constexpr bool uses_extra = true;
+
+    static __forceinline bool match(DataType a, DataType b, DataType c) { return static_cast<DataType>(b - a) == c; }
+    static compare_predicate<DataType> vectorized(DataType, DataType) { return {}; }
+
+    static diff_predicate<DataType> diff(DataType c) {
+        if constexpr (has_compare_kernels<DataType>)
+            return { get_diff_kernel<DataType>(diff_op::decreased_by), c };
+        else
+            return {};
+    }
+};
+
+// Resolves the runtime scan type once and calls func.template operator()<Predicate>().
+// Unknown values are handled as unknown_value, which matches nothing.
+template <typename DataType, typename F>
+decltype(auto) with_scan_predicate(scan_type type, F&& func) {
+    switch (type) {
+    case scan_type::exact_value:     return func.template operator()<scan_predicate<scan_type::exact_value, DataType>>();
+    case scan_type::bigger_than:     return func.template operator()<scan_predicate<scan_type::bigger_than, DataType>>();
+    case scan_type::smaller_than:    return func.template operator()<scan_predicate<scan_type::smaller_than, DataType>>();
+    case scan_type::value_between:   return func.template operator()<scan_predicate<scan_type::value_between, DataType>>();
+    case scan_type::changed:         return func.template operator()<scan_predicate<scan_type::changed, DataType>>();
+    case scan_type::unchanged:       return func.template operator()<scan_predicate<scan_type::unchanged, DataType>>();
+    case scan_type::increased_value: return func.template operator()<scan_predicate<scan_type::increased_value, DataType>>();
+    case scan_type::decreased_value: return func.template operator()<scan_predicate<scan_type::decreased_value, DataType>>();
+    case scan_type::increased_by:    return func.template operator()<scan_predicate<scan_type::increased_by, DataType>>();
+    case scan_type::decreased_by:    return func.template operator()<scan_predicate<scan_type::decreased_by, DataType>>();
+    default:                         return func.template operator()<scan_predicate<scan_type::unknown_value, DataType>>();
+    }
+}
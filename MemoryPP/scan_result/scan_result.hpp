@@ -1,17 +1,19 @@
 #pragma once
-#include <functional>
 #include <memory>
 #include <span>
 #include <stdexcept>
 #include <utility>
 #include <optional>
 #include <array>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <type_traits>
 
 #include "../file_dump/file_dump.hpp"
 #include "../memory_reagion/memory_region.hpp"
 #include "../custom_map.hpp"
-
-#include "../deferred_processor.hpp"
+#include "../simd/compare_kernels.hpp"
 
 extern file_dump results;
 
@@ -29,6 +31,7 @@ enum scan_type {
     value_between
 };
 
+// A hit as produced by the searches, results keep values and offsets apart.
 template<typename DataType>
 struct scan_entry {
     DataType value;
@@ -40,18 +43,61 @@ struct result_header {
     uint64_t size;
 };
 
+// How the hits of a result are held. Entries store every value and its offset in the region, bitmaps one bit
+// per element of the region and read the values back from it, cheaper once hits are dense.
+enum class result_encoding {
+    entries,
+    bitmap
+};
+
 
 template <typename DataType>
-class scan_result : public dumpable<result_header, scan_entry<DataType>>
+class scan_result : public dumpable<result_header, DataType>
 {
     std::shared_ptr<memory_region> _associated_region;  // Now using shared_ptr
     scan_type _type;
     size_t _index;
 
+    result_encoding _encoding{ result_encoding::entries };
+    std::vector<uint64_t> _bitmap;  // Bit i set when the element at i * _stride matched.
+    size_t _stride{ sizeof(DataType) };
+
+    // Entries are held as a packed array of values, the dumpable data, and their offsets from the region base.
+    // Regions bigger than 4 GB fall back to 64-bit offsets.
+    std::vector<uint32_t> _offsets;
+    std::vector<uint64_t> _wide_offsets;
+
+    __forceinline bool wide_offsets() { return _associated_region->size() > UINT32_MAX; }
+
+    __forceinline void append(DataType value, uint64_t address) {
+        uint64_t offset = address - region_base();
+
+        this->_data.push_back(value);
+
+        if (wide_offsets())
+            _wide_offsets.push_back(offset);
+        else
+            _offsets.push_back(static_cast<uint32_t>(offset));
+    }
+
+    // rescan of entries: the new values of the previous hits are gathered in blocks and filtered by the kernels.
+    template <typename Predicate>
+    size_t rescan_entries(scan_result& previous, const DataType& value1, const DataType& extra, const diff_predicate<DataType>& diff, uint64_t begin, uint64_t end);
+
+    // Runs kernel(offset, count, mask) over the elements [begin_index, end_index), each call covering count values
+    // packed sizeof(DataType) apart from byte offset, and calls emit(index) for every match in address order.
+    template <typename Kernel, typename Emit>
+    static void run_kernel(size_t begin_index, size_t end_index, size_t stride, Kernel&& kernel, Emit&& emit);
+
+    // Calls search(bytes, offset, begin, end) over the parts of [begin_index, end_index) held in memory, bytes holding
+    // the region from offset on. A sparse region gives one part per run, values crossing the end of a run are left out.
+    template <typename Search>
+    void for_each_part(size_t begin_index, size_t end_index, size_t stride, Search&& search);
+
 public:
     // Constructor now accepts a shared_ptr to memory_region.
     scan_result(std::shared_ptr<memory_region> region, size_t index = 0)
-        : dumpable<result_header, scan_entry<DataType>>(results), _associated_region(std::move(region)), _index(index)
+        : dumpable<result_header, DataType>(results), _associated_region(std::move(region)), _index(index)
     {
     }
 
@@ -61,9 +107,14 @@ public:
 
     // Move constructor.
     scan_result(scan_result&& other) noexcept
-        : dumpable<result_header, scan_entry<DataType>>(std::move(other)),
+        : dumpable<result_header, DataType>(std::move(other)),
         _associated_region(std::move(other._associated_region)),  // Shared pointer move is fine
-        _index(std::exchange(other._index, -1))
+        _index(std::exchange(other._index, -1)),
+        _encoding(other._encoding),
+        _bitmap(std::move(other._bitmap)),
+        _stride(other._stride),
+        _offsets(std::move(other._offsets)),
+        _wide_offsets(std::move(other._wide_offsets))
     {
     }
 
@@ -72,9 +123,14 @@ public:
     {
         if (this != &other)
         {
-            dumpable<result_header, scan_entry<DataType>>::operator=(std::move(other));
+            dumpable<result_header, DataType>::operator=(std::move(other));
             _associated_region = std::move(other._associated_region);  // Shared pointer move is fine
             _index = std::exchange(other._index, -1);
+            _encoding = other._encoding;
+            _bitmap = std::move(other._bitmap);
+            _stride = other._stride;
+            _offsets = std::move(other._offsets);
+            _wide_offsets = std::move(other._wide_offsets);
         }
         return *this;
     }
@@ -84,98 +140,699 @@ public:
     __forceinline void set_type(scan_type type) { _type = type; }
     __forceinline scan_type type() { return _type; }
 
-    // Function accepts a comparator to decide if a value matches.
-    bool search_value(std::function<bool(DataType, DataType, std::optional<DataType>)> comparator, const DataType& value1, std::optional<DataType> value2);
+    // Elements are the values starting every stride bytes from the region base. The natural stride only finds
+    // aligned values, smaller ones find unaligned values too, larger ones compare less data.
+
+    // Number of elements with the given stride that fit in size bytes.
+    static __forceinline size_t element_count(size_t size, size_t stride) {
+        return size < sizeof(DataType) ? 0 : (size - sizeof(DataType)) / stride + 1;
+    }
+
+    // The kernels only run on strides that split a value into whole steps, one pass per step.
+    static __forceinline bool kernel_stride(size_t stride) {
+        return stride != 0 && stride <= sizeof(DataType) && sizeof(DataType) % stride == 0;
+    }
+
+    // Values may sit at any byte offset when the stride is smaller than the value.
+    static __forceinline DataType load_value(const uint8_t* data) {
+        DataType value;
+        std::memcpy(&value, data, sizeof(DataType));
+        return value;
+    }
+
+    // Scans the elements [begin_index, end_index) of the region, appending those accepted by match(value) to out.
+    // Does not touch the result itself, so disjoint ranges can be searched concurrently.
+    template <typename Match>
+    void search_range(Match&& match, size_t begin_index, size_t end_index, std::vector<scan_entry<DataType>>& out, size_t stride = sizeof(DataType));
+
+    // Same as search_range, evaluating the predicate with a vectorized kernel. Requires a kernel_stride.
+    void search_kernel(const compare_predicate<DataType>& predicate, size_t begin_index, size_t end_index, std::vector<scan_entry<DataType>>& out, size_t stride = sizeof(DataType));
+
+    // Forms of the above searching bytes that hold the region from offset on, for regions streamed in chunks.
+    // The elements of [begin_index, end_index) must lie in bytes.
+    template <typename Match>
+    void search_range(Match&& match, const uint8_t* bytes, size_t offset, size_t begin_index, size_t end_index, std::vector<scan_entry<DataType>>& out, size_t stride = sizeof(DataType));
+    void search_kernel(const compare_predicate<DataType>& predicate, const uint8_t* bytes, size_t offset, size_t begin_index, size_t end_index, std::vector<scan_entry<DataType>>& out, size_t stride = sizeof(DataType));
+
+    // Streams the snapshot of an unknown_value scan against the region of this result and appends
+    // the elements of the snapshot whose new value passes the diff kernel. Elements are laid out
+    // from the snapshot base, those the region does not cover are skipped. Requires a kernel_stride.
+    // A filter bitmap over the snapshot elements only lets the elements whose bit is set through.
+    // Only the elements starting in [begin, end) are diffed.
+    void search_diff(const diff_predicate<DataType>& predicate, memory_region& snapshot, std::vector<scan_entry<DataType>>& out, size_t stride = sizeof(DataType),
+        const uint64_t* filter = nullptr, uint64_t begin = 0, uint64_t end = UINT64_MAX);
+
+    // Appends the elements of a previous result whose value in the region of this result still matches
+    // the predicate, returning how many were added. Snapshots of unknown_value scans go through diff when
+    // the stride allows it. value1 and extra are the operands of a next scan, see scan_predicate.
+    // Only the elements starting in [begin, end) are rescanned, disjoint windows of a region can go to separate results.
+    template <typename Predicate>
+    size_t rescan(scan_result& previous, const DataType& value1, const DataType& extra, const diff_predicate<DataType>& diff, size_t stride = sizeof(DataType),
+        uint64_t begin = 0, uint64_t end = UINT64_MAX);
+
+    __forceinline size_t total_elements(size_t stride = sizeof(DataType)) { return element_count(_associated_region->size(), stride); }
+
+    // Switches to a bitmap once it takes less memory than the entries, stride being the one the hits were found with.
+    // The values are then read back from the region, which has to stay valid.
+    void encode(size_t stride = sizeof(DataType));
+
+    __forceinline result_encoding encoding() const { return _encoding; }
+
+    // Number of hits, whatever the encoding.
+    __forceinline size_t count() const { return this->_valid ? this->_header.size : 0; }
+
+    // Calls func(value, address) for every hit in address order, without expanding a bitmap.
+    // Only the hits in [begin, end) when given.
+    template <typename Func>
+    void for_each_element(Func&& func, uint64_t begin = 0, uint64_t end = UINT64_MAX);
 
     __forceinline void add_element(const scan_entry<DataType>& entry) {
-        this->_data.push_back(entry);
+        append(entry.value, entry.address);
         this->_header.size++;
         this->_valid = true;
     }
 
+    __forceinline void add_elements(std::span<const scan_entry<DataType>> entries) {
+        if (entries.empty())
+            return;
+
+        this->_data.reserve(this->_data.size() + entries.size());
+
+        for (auto& entry : entries)
+            append(entry.value, entry.address);
+
+        this->_header.size += entries.size();
+        this->_valid = true;
+    }
+
+    // Appends the entries of part, a result of the same region whose hits all come after those of this one.
+    void add_elements(scan_result& part) {
+        auto values = part.values();
+
+        for (size_t i = 0; i < values.size(); i++)
+            append(values[i], part.region_base() + part.offset_at(i));
+
+        this->_header.size += values.size();
+        this->_valid = this->_valid || !values.empty();
+    }
+
     __forceinline uint64_t region_base() { return _associated_region->base(); }
 
     __forceinline size_t region_size() { return _associated_region->size(); }
 
-    __forceinline std::shared_ptr< memory_region> associated_region() { return _associated_region; }
+    __forceinline const std::shared_ptr<memory_region>& associated_region() const { return _associated_region; }
 
-    std::span<scan_entry<DataType>> elements() {
-        if (!this->_valid)
-            std::span<scan_entry<DataType>>();
+    // Values of an entries encoded result, empty once encoded as a bitmap, see for_each_element.
+    std::span<DataType> values() {
+        if (_encoding != result_encoding::entries)
+            return std::span<DataType>();
 
-        // Access the in-memory vector if it's not discarded.
-        if (!this->_discarded) {
-            return this->_data;
-        }
+        return this->view();
+    }
 
-        if (!this->_mapped_info && !this->load())
-            std::span<scan_entry<DataType>>();
+    // Offset from the region base of the i-th value.
+    __forceinline uint64_t offset_at(size_t i) const { return _wide_offsets.empty() ? _offsets[i] : _wide_offsets[i]; }
 
-        // Access the mapped span.
-        return this->_data_map;
-    }
+    // Index of the first entry at or after address, entries being sorted.
+    size_t first_entry_at(uint64_t address);
 };
 
 template<typename DataType>
-inline bool scan_result<DataType>::search_value(std::function<bool(DataType, DataType, std::optional<DataType>)> comparator, const DataType& value1, std::optional<DataType> value2)
+template<typename Kernel, typename Emit>
+inline void scan_result<DataType>::run_kernel(size_t begin_index, size_t end_index, size_t stride, Kernel&& kernel, Emit&& emit)
 {
-    this->_data.reserve(20);
+    // Elements compared per kernel call, the mask stays on the stack.
+    constexpr size_t BLOCK_ELEMENTS = 4096;
+    uint64_t mask[BLOCK_ELEMENTS / 64];
+
+    // Element i belongs to pass i % passes, the elements of a pass are packed sizeof(DataType) apart,
+    // so a stride of 1 reads every value with overlapping loads, one pass per byte of the value.
+    const size_t passes = sizeof(DataType) / stride;
 
-    auto total_elements = _associated_region->size() / sizeof(DataType);
+    std::vector<size_t> block_hits;
 
-    constexpr size_t PARALLEL_THRESHOLD = 10000;
+    for (size_t block = begin_index; block < end_index; block += BLOCK_ELEMENTS * passes) {
+        size_t block_end = std::min(end_index, block + BLOCK_ELEMENTS * passes);
 
-    if (total_elements < PARALLEL_THRESHOLD) {
-        for (size_t i = 0; i < total_elements; i++) {
-            auto value = _associated_region->at_index<DataType>(i);
-            if (value && comparator(*value, value1, value2)) {
-                auto address = _associated_region->base() + i * sizeof(DataType);
-                scan_entry<DataType> entry{ *value, address };
-                this->_data.push_back(entry);
-                this->_header.size++;
-                this->_valid = true;
+        for (size_t pass = 0; pass < passes; pass++) {
+            size_t first = block > pass ? (block - pass + passes - 1) / passes : 0;
+            size_t last = block_end > pass ? (block_end - pass + passes - 1) / passes : 0;
+
+            if (first >= last)
+                continue;
+
+            size_t count = last - first;
+            kernel(pass * stride + first * sizeof(DataType), count, mask);
+
+            for (size_t word = 0; word < (count + 63) / 64; word++) {
+                uint64_t bits = mask[word];
+
+                while (bits) {
+                    size_t index = pass + (first + word * 64 + std::countr_zero(bits)) * passes;
+
+                    if (passes == 1)
+                        emit(index);
+                    else
+                        block_hits.push_back(index);
+
+                    bits &= bits - 1;
+                }
             }
         }
-        return this->_valid;
+
+        if (passes > 1) {
+            std::sort(block_hits.begin(), block_hits.end());
+
+            for (auto index : block_hits)
+                emit(index);
+
+            block_hits.clear();
+        }
     }
+}
 
+template<typename DataType>
+template<typename Search>
+inline void scan_result<DataType>::for_each_part(size_t begin_index, size_t end_index, size_t stride, Search&& search)
+{
+    auto& region = *_associated_region;
 
-    std::array<deferred_processor, 4> _processors;
+    if (!region.is_sparse()) {
+        auto bytes = region.view();
 
-    size_t jobs = _processors.size();  // Supponiamo jobs == 4.
-    size_t elements_per_processor = total_elements / jobs;
-    std::vector<std::vector<scan_entry<DataType>>> local_results(jobs);
+        if (end_index <= element_count(bytes.size(), stride))
+            search(bytes.data(), 0, begin_index, end_index);
+        return;
+    }
 
-    std::atomic<size_t> pending_count(jobs);
+    for (auto& run : region.runs()) {
+        if (!run.valid)
+            continue;
 
-    for (size_t j = 0; j < jobs; ++j) {
-        size_t start_index = j * elements_per_processor;
-        size_t end_index = (j == jobs - 1) ? total_elements : start_index + elements_per_processor;
+        size_t run_end = run.offset + run.size;
+        size_t first = std::max(begin_index, (run.offset + stride - 1) / stride);
+        size_t last = std::min(end_index, run_end < sizeof(DataType) ? 0 : (run_end - sizeof(DataType)) / stride + 1);
 
-        _processors[j].add_operation([this, j, start_index, end_index, &local_results, &comparator, &value1, &value2, &pending_count]() {
-            // Scansione del chunk assegnato.
-            for (size_t i = start_index; i < end_index; i++) {
-                auto value = _associated_region->at_index<DataType>(i);
-                if (value && comparator(*value, value1, value2)) {
-                    auto address = _associated_region->base() + i * sizeof(DataType);
-                    local_results[j].push_back({ *value, address });
-                }
-            }
-            pending_count--;
+        if (first < last)
+            search(region.run_data(run), run.offset, first, last);
+    }
+}
+
+template<typename DataType>
+template<typename Match>
+inline void scan_result<DataType>::search_range(Match&& match, size_t begin_index, size_t end_index, std::vector<scan_entry<DataType>>& out, size_t stride)
+{
+    for_each_part(begin_index, end_index, stride, [&](const uint8_t* bytes, size_t offset, size_t begin, size_t end) {
+        search_range(match, bytes, offset, begin, end, out, stride);
+    });
+}
+
+template<typename DataType>
+template<typename Match>
+inline void scan_result<DataType>::search_range(Match&& match, const uint8_t* bytes, size_t offset, size_t begin_index, size_t end_index, std::vector<scan_entry<DataType>>& out, size_t stride)
+{
+    auto base = _associated_region->base();
+
+    for (size_t i = begin_index; i < end_index; i++) {
+        DataType value = load_value(bytes + (i * stride - offset));
+
+        if (match(value))
+            out.push_back({ value, base + i * stride });
+    }
+}
+
+template<typename DataType>
+inline void scan_result<DataType>::search_kernel(const compare_predicate<DataType>& predicate, size_t begin_index, size_t end_index, std::vector<scan_entry<DataType>>& out, size_t stride)
+{
+    for_each_part(begin_index, end_index, stride, [&](const uint8_t* bytes, size_t offset, size_t begin, size_t end) {
+        search_kernel(predicate, bytes, offset, begin, end, out, stride);
+    });
+}
+
+template<typename DataType>
+inline void scan_result<DataType>::search_kernel(const compare_predicate<DataType>& predicate, const uint8_t* bytes, size_t offset, size_t begin_index, size_t end_index,
+    std::vector<scan_entry<DataType>>& out, size_t stride)
+{
+    auto base = _associated_region->base();
+
+    run_kernel(begin_index, end_index, stride,
+        [&](size_t at, size_t count, uint64_t* mask) {
+            predicate.kernel(reinterpret_cast<const DataType*>(bytes + (at - offset)), count, predicate.low, predicate.high, mask);
+        },
+        [&](size_t index) {
+            out.push_back({ load_value(bytes + (index * stride - offset)), base + index * stride });
+        });
+}
+
+template<typename DataType>
+inline void scan_result<DataType>::search_diff(const diff_predicate<DataType>& predicate, memory_region& snapshot, std::vector<scan_entry<DataType>>& out, size_t stride,
+    const uint64_t* filter, uint64_t begin, uint64_t end)
+{
+    auto new_bytes = _associated_region->view();
+
+    uint64_t old_base = snapshot.base();
+    uint64_t new_base = _associated_region->base();
+    uint64_t new_end = new_base + new_bytes.size();
+
+    if (!snapshot.is_valid() || snapshot.size() == 0 || new_bytes.empty() || new_end <= old_base)
+        return;
+
+    // Snapshot elements whose whole value lies inside the new region.
+    size_t begin_index = new_base > old_base ? static_cast<size_t>((new_base - old_base + stride - 1) / stride) : 0;
+    size_t end_index = element_count(static_cast<size_t>(std::min<uint64_t>(snapshot.size(), new_end - old_base)), stride);
+
+    // Elements starting in the window.
+    if (begin > old_base)
+        begin_index = std::max(begin_index, static_cast<size_t>((begin - old_base + stride - 1) / stride));
+
+    if (end <= old_base)
+        return;
+
+    if (end - old_base < snapshot.size())
+        end_index = std::min(end_index, static_cast<size_t>((end - old_base + stride - 1) / stride));
+
+    if (begin_index >= end_index)
+        return;
+
+    // Offsets are relative to the snapshot base, the new buffer starts at new_base.
+    auto new_value = [&](size_t offset) { return new_bytes.data() + (old_base + offset - new_base); };
+
+    // Diffs the elements [first, last) against old bytes holding the snapshot from old_offset on.
+    auto diff_range = [&](const uint8_t* old_data, size_t old_offset, size_t first, size_t last) {
+        run_kernel(first, last, stride,
+            [&](size_t offset, size_t count, uint64_t* mask) {
+                predicate.kernel(reinterpret_cast<const DataType*>(old_data + (offset - old_offset)), reinterpret_cast<const DataType*>(new_value(offset)), count, predicate.operand, mask);
+            },
+            [&](size_t index) {
+                if (filter && !((filter[index / 64] >> (index % 64)) & 1))
+                    return;
+
+                out.push_back({ load_value(new_value(index * stride)), old_base + index * stride });
             });
+    };
+
+    // Diffs the elements [first, last) against the snapshot.
+    auto compare = [&](size_t first, size_t last) {
+        if (first >= last)
+            return;
+
+        if (!snapshot.is_compressed()) {
+            auto old_bytes = snapshot.view();
+
+            if (!old_bytes.empty())
+                diff_range(old_bytes.data(), 0, first, last);
+
+            return;
+        }
+
+        // Compressed snapshots are decoded a chunk at a time, each chunk also holds the tail of its last value.
+        constexpr size_t CHUNK_BYTES = 64 * 1024;
+        const size_t chunk_elements = std::max<size_t>(1, CHUNK_BYTES / stride);
+        std::vector<uint8_t> chunk;
+
+        for (size_t chunk_first = first; chunk_first < last; chunk_first += chunk_elements) {
+            size_t chunk_last = std::min(last, chunk_first + chunk_elements);
+            size_t chunk_offset = chunk_first * stride;
+
+            chunk.resize((chunk_last - 1) * stride + sizeof(DataType) - chunk_offset);
+
+            if (!snapshot.read_snapshot(chunk_offset, chunk.size(), chunk.data()))
+                return;
+
+            diff_range(chunk.data(), chunk_offset, chunk_first, chunk_last);
+        }
+    };
+
+    // Floating point pages hashed alike may hold NaNs, which compare unequal to themselves, so every element is diffed.
+    if constexpr (!std::is_integral_v<DataType>) {
+        compare(begin_index, end_index);
+        return;
     }
 
-    while (pending_count.load() != 0) {
-        std::this_thread::yield();
+    // Every element of a page hashed alike on both sides compares equal values, so they all share the
+    // outcome of the kernel over a pair of equal values, found once here.
+    DataType same_value{};
+    uint64_t same_mask[1];
+    predicate.kernel(&same_value, &same_value, 1, predicate.operand, same_mask);
+    const bool keep_same = same_mask[0] & 1;
+
+    size_t next = begin_index;
+    size_t end_offset = (end_index - 1) * stride + sizeof(DataType);
+
+    for (size_t page = begin_index * stride / memory_region::PAGE_BYTES; page * memory_region::PAGE_BYTES < end_offset;) {
+        if (!memory_region::same_page(snapshot, *_associated_region, old_base + page * memory_region::PAGE_BYTES)) {
+            page++;
+            continue;
+        }
+
+        size_t run_end = page + 1;
+
+        while (run_end * memory_region::PAGE_BYTES < end_offset && memory_region::same_page(snapshot, *_associated_region, old_base + run_end * memory_region::PAGE_BYTES))
+            run_end++;
+
+        // Elements lying wholly inside the unchanged pages.
+        size_t first = std::max(next, (page * memory_region::PAGE_BYTES + stride - 1) / stride);
+        size_t last = std::min(end_index, element_count(run_end * memory_region::PAGE_BYTES, stride));
+
+        page = run_end;
+
+        if (first >= last)
+            continue;
+
+        compare(next, first);
+
+        if (keep_same) {
+            for (size_t index = first; index < last; index++) {
+                if (!filter || ((filter[index / 64] >> (index % 64)) & 1))
+                    out.push_back({ load_value(new_value(index * stride)), old_base + index * stride });
+            }
+        }
+
+        next = last;
+    }
+
+    compare(next, end_index);
+}
+
+template<typename DataType>
+template<typename Predicate>
+inline size_t scan_result<DataType>::rescan(scan_result& previous, const DataType& value1, const DataType& extra, const diff_predicate<DataType>& diff, size_t stride,
+    uint64_t begin, uint64_t end)
+{
+    auto& prev_region = previous.associated_region();
+
+    if (!prev_region)
+        return 0;
+
+    size_t found = 0;
+
+    auto check = [&](DataType old_value, uint64_t address) {
+        if (address < begin || address >= end)
+            return;
+
+        auto new_pointer = _associated_region->template at_address<DataType>(address);
+
+        if (!new_pointer)
+            return;
+
+        DataType new_value = load_value(reinterpret_cast<const uint8_t*>(new_pointer));
+        bool matched;
+
+        if constexpr (Predicate::relative)
+            matched = Predicate::match(new_value, old_value, value1);
+        else
+            matched = Predicate::match(new_value, value1, extra);
+
+        if (matched) {
+            add_element({ new_value, address });
+            found++;
+        }
+    };
+
+    if (previous.type() != scan_type::unknown_value) {
+        // Dense previous hits are diffed like a snapshot, masked by their bitmap.
+        if (previous.encoding() == result_encoding::bitmap && previous._stride == stride && diff.kernel && kernel_stride(stride)) {
+            std::vector<scan_entry<DataType>> hits;
+            search_diff(diff, *prev_region, hits, stride, previous._bitmap.data(), begin, end);
+            add_elements(hits);
+
+            return hits.size();
+        }
+
+        if (previous.encoding() == result_encoding::entries)
+            return rescan_entries<Predicate>(previous, value1, extra, diff, begin, end);
+
+        previous.for_each_element(check, begin, end);
+
+        return found;
+    }
+
+    // Snapshots are streamed against the new values in one pass instead of element by element.
+    if (diff.kernel && kernel_stride(stride)) {
+        std::vector<scan_entry<DataType>> hits;
+        search_diff(diff, *prev_region, hits, stride, nullptr, begin, end);
+        add_elements(hits);
+
+        return hits.size();
+    }
+
+    //we can't access the elements since we didnt create the elements in the first scan
+    uint64_t old_base = prev_region->base();
+
+    if (end <= old_base)
+        return 0;
+
+    size_t first = begin > old_base ? static_cast<size_t>((begin - old_base + stride - 1) / stride) : 0;
+    size_t last = element_count(prev_region->size(), stride);
+
+    if (end - old_base < prev_region->size())
+        last = std::min(last, static_cast<size_t>((end - old_base + stride - 1) / stride));
+
+    // Old values are decoded a chunk at a time through read_snapshot, which only reads the region, so compressed
+    // snapshots are never expanded whole and tasks sharing the snapshot don't race on it.
+    constexpr size_t CHUNK_BYTES = 64 * 1024;
+    const size_t chunk_elements = std::max<size_t>(1, CHUNK_BYTES / stride);
+    std::vector<uint8_t> chunk;
+
+    for (size_t chunk_first = first; chunk_first < last; chunk_first += chunk_elements) {
+        size_t chunk_last = std::min(last, chunk_first + chunk_elements);
+        size_t chunk_offset = chunk_first * stride;
+
+        chunk.resize((chunk_last - 1) * stride + sizeof(DataType) - chunk_offset);
+
+        if (!prev_region->read_snapshot(chunk_offset, chunk.size(), chunk.data()))
+            break;
+
+        for (size_t i = chunk_first; i < chunk_last; i++)
+            check(load_value(chunk.data() + (i - chunk_first) * stride), old_base + i * stride);
+    }
+
+    return found;
+}
+
+template<typename DataType>
+inline void scan_result<DataType>::encode(size_t stride)
+{
+    // Bitmaps read their values back from the region, which sparse and streamed reads do not hold whole.
+    if (_encoding != result_encoding::entries || this->_data.empty() || _associated_region->is_sparse() || _associated_region->is_streamed())
+        return;
+
+    size_t words = (total_elements(stride) + 63) / 64;
+
+    size_t entry_bytes = sizeof(DataType) + (wide_offsets() ? sizeof(uint64_t) : sizeof(uint32_t));
+
+    if (words * sizeof(uint64_t) >= this->_data.size() * entry_bytes)
+        return;
+
+    _bitmap.assign(words, 0);
+
+    for (size_t i = 0; i < this->_data.size(); i++) {
+        size_t index = static_cast<size_t>(offset_at(i) / stride);
+        _bitmap[index / 64] |= 1ull << (index % 64);
     }
 
+    _stride = stride;
+    _encoding = result_encoding::bitmap;
+
     this->_data.clear();
+    this->_data.shrink_to_fit();
+    this->_data_map = std::span<DataType>();
+    _offsets = {};
+    _wide_offsets = {};
+}
+
+template<typename DataType>
+template<typename Func>
+inline void scan_result<DataType>::for_each_element(Func&& func, uint64_t begin, uint64_t end)
+{
+    uint64_t base = region_base();
+
+    if (end <= base)
+        return;
+
+    if (_encoding == result_encoding::entries) {
+        auto data = values();
+        size_t last = data.empty() ? 0 : first_entry_at(end);
+
+        for (size_t i = first_entry_at(begin); i < last; i++)
+            func(data[i], base + offset_at(i));
+
+        return;
+    }
+
+    auto bytes = _associated_region->view();
+
+    if (bytes.empty())
+        return;
+
+    // Elements starting in the window.
+    size_t first = begin > base ? static_cast<size_t>((begin - base + _stride - 1) / _stride) : 0;
+    uint64_t window = end - base;
+    size_t last = static_cast<size_t>(std::min<uint64_t>(_bitmap.size() * 64, window / _stride + (window % _stride != 0)));
 
-    for (size_t j = 0; j < jobs; j++) {
-        this->_data.insert(this->_data.end(), local_results[j].begin(), local_results[j].end());
+    for (size_t word = first / 64; word * 64 < last; word++) {
+        uint64_t bits = _bitmap[word];
+
+        // Bits outside the window are cleared at both ends.
+        if (word == first / 64)
+            bits &= ~0ull << (first % 64);
+
+        if (word == last / 64)
+            bits &= (1ull << (last % 64)) - 1;
+
+        while (bits) {
+            size_t offset = (word * 64 + std::countr_zero(bits)) * _stride;
+            func(load_value(bytes.data() + offset), base + offset);
+            bits &= bits - 1;
+        }
+    }
+}
+
+template<typename DataType>
+inline size_t scan_result<DataType>::first_entry_at(uint64_t address)
+{
+    uint64_t base = region_base();
+
+    if (address <= base)
+        return 0;
+
+    uint64_t offset = address - base;
+    size_t low = 0;
+    size_t high = _wide_offsets.empty() ? _offsets.size() : _wide_offsets.size();
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+
+        if (offset_at(middle) < offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+template<typename DataType>
+template<typename Predicate>
+inline size_t scan_result<DataType>::rescan_entries(scan_result& previous, const DataType& value1, const DataType& extra, const diff_predicate<DataType>& diff,
+    uint64_t begin, uint64_t end)
+{
+    auto old_values = previous.values();
+
+    if (old_values.empty() || !_associated_region->is_valid())
+        return 0;
+
+    // The region is either read whole or only around the previous hits, a single run covers the first case.
+    std::vector<region_run> whole;
+    auto runs = _associated_region->runs();
+
+    const uint8_t* whole_data = nullptr;
+
+    if (!_associated_region->is_sparse()) {
+        auto bytes = _associated_region->view();
+        whole.push_back({ 0, bytes.size(), 0, true });
+        whole_data = bytes.data();
+        runs = whole;
+    }
+
+    compare_predicate<DataType> compare{};
+
+    if constexpr (!Predicate::relative)
+        compare = Predicate::vectorized(value1, extra);
+
+    uint64_t old_base = previous.region_base();
+    uint64_t new_base = region_base();
+
+    // A previous result overlapping several regions only rescans the hits that fall in this one, and in the window.
+    size_t first_hit = previous.first_entry_at(std::max(new_base, begin));
+    size_t last_hit = previous.first_entry_at(std::min(new_base + region_size(), end));
+
+    if (first_hit >= last_hit)
+        return 0;
+
+    // Previous hits are sorted, the run holding the next one is found by moving forward.
+    size_t run = 0;
+
+    auto locate = [&](uint64_t address) -> const uint8_t* {
+        if (address < new_base)
+            return nullptr;
+
+        uint64_t offset = address - new_base;
+
+        while (run < runs.size() && runs[run].offset + runs[run].size <= offset)
+            run++;
+
+        if (run == runs.size() || offset < runs[run].offset || offset + sizeof(DataType) > runs[run].offset + runs[run].size || !runs[run].valid)
+            return nullptr;
+
+        if (whole_data)
+            return whole_data + offset;
+
+        return _associated_region->run_data(runs[run]) + (offset - runs[run].offset);
+    };
+
+    constexpr size_t BLOCK_ELEMENTS = 4096;
+    DataType gathered[BLOCK_ELEMENTS];
+    uint64_t mask[BLOCK_ELEMENTS / 64];
+    uint64_t present[BLOCK_ELEMENTS / 64];
+
+    size_t found = 0;
+
+    for (size_t block = first_hit; block < last_hit; block += BLOCK_ELEMENTS) {
+        size_t count = std::min(BLOCK_ELEMENTS, last_hit - block);
+        size_t words = (count + 63) / 64;
+
+        std::fill_n(present, words, 0);
+
+        // Hits the region no longer holds keep their old value and are masked out.
+        for (size_t k = 0; k < count; k++) {
+            auto data = locate(old_base + previous.offset_at(block + k));
+
+            if (data) {
+                gathered[k] = load_value(data);
+                present[k / 64] |= 1ull << (k % 64);
+            }
+            else {
+                gathered[k] = old_values[block + k];
+            }
+        }
+
+        if (Predicate::relative && diff.kernel) {
+            diff.kernel(old_values.data() + block, gathered, count, diff.operand, mask);
+        }
+        else if (!Predicate::relative && compare.kernel) {
+            compare.kernel(gathered, count, compare.low, compare.high, mask);
+        }
+        else {
+            std::fill_n(mask, words, 0);
+
+            for (size_t k = 0; k < count; k++) {
+                bool matched;
+
+                if constexpr (Predicate::relative)
+                    matched = Predicate::match(gathered[k], old_values[block + k], value1);
+                else
+                    matched = Predicate::match(gathered[k], value1, extra);
+
+                if (matched)
+                    mask[k / 64] |= 1ull << (k % 64);
+            }
+        }
+
+        for (size_t word = 0; word < words; word++) {
+            uint64_t bits = mask[word] & present[word];
+
+            while (bits) {
+                size_t k = word * 64 + std::countr_zero(bits);
+                append(gathered[k], old_base + previous.offset_at(block + k));
+                found++;
+                bits &= bits - 1;
+            }
+        }
     }
-    this->_header.size = this->_data.size();
-    this->_valid = !this->_data.empty();
 
-    return this->_valid;
-}
\ No newline at end of file
+    this->_header.size += found;
+    this->_valid = this->_valid || found != 0;
+
+    return found;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "../platform.hpp"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A byte pattern. Every byte is compared under its mask, so a nibble wildcard only checks the other half.
+struct signature {
+    std::vector<uint8_t> bytes;     // Already masked.
+    std::vector<uint8_t> masks;
+
+    // Parses patterns like "48 8B ?? ?? 89". "?" and "??" skip a byte, "4?" and "?8" skip a nibble.
+    // Fails on malformed tokens and on patterns without any fully known byte.
+    static std::optional<signature> parse(std::string_view pattern);
+
+    __forceinline size_t size() const { return bytes.size(); }
+
+    // data must hold at least size() bytes.
+    __forceinline bool matches(const uint8_t* data) const {
+        for (size_t i = 0; i < bytes.size(); i++) {
+            if ((data[i] & masks[i]) != bytes[i])
+                return false;
+        }
+        return true;
+    }
+};
+
+struct signature_match {
+    uint32_t signature;     // Index in the signature_set.
+    uint64_t address;
+};
+
+// Searches many signatures in one pass. Every signature is anchored on its rarest fully known byte pair,
+// or on a single byte when it has no pair, and a lookup on the anchor rejects most positions before any
+// signature is compared. With few distinct anchor bytes the positions are first filtered with the
+// vectorized byte compare.
+class signature_set {
+    struct anchor {
+        uint32_t signature;
+        uint32_t offset;    // Of the anchor inside the signature.
+    };
+
+    // Up to this many distinct leading anchor bytes are filtered with the compare kernels.
+    static constexpr size_t VECTOR_FILTER_BYTES = 8;
+
+    std::vector<signature> _signatures;
+    size_t _max_size{ 0 };
+
+    // One bit per byte pair (first byte in the low half) that may start an anchor.
+    std::vector<uint64_t> _pair_filter = std::vector<uint64_t>(65536 / 64);
+    std::unordered_map<uint16_t, std::vector<anchor>> _pair_anchors;
+    std::array<std::vector<anchor>, 256> _byte_anchors;
+
+    std::array<bool, 256> _is_first_byte{};
+    std::vector<uint8_t> _first_bytes;
+
+    void check(const uint8_t* data, size_t size, size_t position, uint64_t base, std::vector<signature_match>& out) const;
+
+public:
+    // Returns the index of the new signature.
+    size_t add(signature pattern);
+
+    __forceinline size_t size() const { return _signatures.size(); }
+    __forceinline size_t max_size() const { return _max_size; }
+    __forceinline const signature& at(size_t index) const { return _signatures[index]; }
+
+    // Appends the matches lying entirely in data, which is mapped at base, ordered by address.
+    void search(const uint8_t* data, size_t size, uint64_t base, std::vector<signature_match>& out) const;
+};
@@ -0,0 +1,237 @@
+#include "../signature.hpp"
+#include "../../simd/compare_kernels.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+// Rough frequency of the bytes that dominate code and data, higher is more common.
+// Anchors avoid them so the filter lets fewer positions through.
+uint32_t byte_weight(uint8_t value) {
+    switch (value) {
+    case 0x00: return 16;
+    case 0xFF: return 10;
+    case 0xCC: return 8;
+    case 0x48: return 8;
+    case 0x8B: return 7;
+    case 0x89: return 6;
+    case 0x0F: return 5;
+    case 0x01: return 5;
+    case 0x24: return 4;
+    case 0x44: return 4;
+    case 0x4C: return 4;
+    case 0x8D: return 4;
+    case 0x83: return 4;
+    case 0x85: return 3;
+    case 0xE8: return 3;
+    case 0x90: return 3;
+    case 0xC3: return 3;
+    default:   return 1;
+    }
+}
+
+int parse_nibble(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c == '?')
+        return -1;
+    return -2;
+}
+
+}
+
+std::optional<signature> signature::parse(std::string_view pattern)
+{
+    signature result;
+    bool known_byte = false;
+    size_t i = 0;
+
+    while (i < pattern.size()) {
+        if (pattern[i] == ' ' || pattern[i] == '\t') {
+            i++;
+            continue;
+        }
+
+        size_t end = i;
+        while (end < pattern.size() && pattern[end] != ' ' && pattern[end] != '\t')
+            end++;
+
+        auto token = pattern.substr(i, end - i);
+        i = end;
+
+        if (token == "?" || token == "??") {
+            result.bytes.push_back(0);
+            result.masks.push_back(0);
+            continue;
+        }
+
+        if (token.size() != 2)
+            return std::nullopt;
+
+        int high = parse_nibble(token[0]);
+        int low = parse_nibble(token[1]);
+
+        if (high == -2 || low == -2)
+            return std::nullopt;
+
+        uint8_t mask = static_cast<uint8_t>((high >= 0 ? 0xF0 : 0) | (low >= 0 ? 0x0F : 0));
+        uint8_t value = static_cast<uint8_t>(((high >= 0 ? high : 0) << 4) | (low >= 0 ? low : 0));
+
+        known_byte |= mask == 0xFF;
+        result.bytes.push_back(value);
+        result.masks.push_back(mask);
+    }
+
+    if (!known_byte)
+        return std::nullopt;
+
+    return result;
+}
+
+size_t signature_set::add(signature pattern)
+{
+    uint32_t index = static_cast<uint32_t>(_signatures.size());
+
+    // Rarest fully known pair, or byte when the signature has no pair.
+    size_t best_offset = 0;
+    uint32_t best_weight = UINT32_MAX;
+    bool pair = false;
+
+    for (size_t i = 0; i + 1 < pattern.size(); i++) {
+        if (pattern.masks[i] != 0xFF || pattern.masks[i + 1] != 0xFF)
+            continue;
+
+        uint32_t weight = byte_weight(pattern.bytes[i]) * byte_weight(pattern.bytes[i + 1]);
+
+        if (weight < best_weight) {
+            best_weight = weight;
+            best_offset = i;
+            pair = true;
+        }
+    }
+
+    if (!pair) {
+        for (size_t i = 0; i < pattern.size(); i++) {
+            if (pattern.masks[i] == 0xFF && byte_weight(pattern.bytes[i]) < best_weight) {
+                best_weight = byte_weight(pattern.bytes[i]);
+                best_offset = i;
+            }
+        }
+    }
+
+    uint8_t first = pattern.bytes[best_offset];
+    anchor entry{ index, static_cast<uint32_t>(best_offset) };
+
+    if (pair) {
+        uint16_t key = static_cast<uint16_t>(first | (pattern.bytes[best_offset + 1] << 8));
+        _pair_anchors[key].push_back(entry);
+        _pair_filter[key / 64] |= 1ull << (key % 64);
+    }
+    else {
+        _byte_anchors[first].push_back(entry);
+
+        for (uint32_t second = 0; second < 256; second++) {
+            uint16_t key = static_cast<uint16_t>(first | (second << 8));
+            _pair_filter[key / 64] |= 1ull << (key % 64);
+        }
+    }
+
+    if (!_is_first_byte[first]) {
+        _is_first_byte[first] = true;
+        _first_bytes.push_back(first);
+    }
+
+    _max_size = std::max(_max_size, pattern.size());
+    _signatures.push_back(std::move(pattern));
+
+    return index;
+}
+
+void signature_set::check(const uint8_t* data, size_t size, size_t position, uint64_t base, std::vector<signature_match>& out) const
+{
+    auto test = [&](const std::vector<anchor>& anchors) {
+        for (auto& entry : anchors) {
+            if (position < entry.offset)
+                continue;
+
+            size_t start = position - entry.offset;
+            auto& pattern = _signatures[entry.signature];
+
+            if (start + pattern.size() <= size && pattern.matches(data + start))
+                out.push_back({ entry.signature, base + start });
+        }
+    };
+
+    if (position + 1 < size && !_pair_anchors.empty()) {
+        uint16_t key = static_cast<uint16_t>(data[position] | (data[position + 1] << 8));
+
+        if (_pair_filter[key / 64] & (1ull << (key % 64))) {
+            auto found = _pair_anchors.find(key);
+
+            if (found != _pair_anchors.end())
+                test(found->second);
+        }
+    }
+
+    test(_byte_anchors[data[position]]);
+}
+
+void signature_set::search(const uint8_t* data, size_t size, uint64_t base, std::vector<signature_match>& out) const
+{
+    if (_signatures.empty() || size == 0)
+        return;
+
+    size_t first_match = out.size();
+
+    if (_first_bytes.size() <= VECTOR_FILTER_BYTES) {
+        // Positions holding one of the anchor bytes, found with the vectorized compare and merged in one mask.
+        constexpr size_t BLOCK_BYTES = 4096;
+        uint64_t mask[BLOCK_BYTES / 64];
+        uint64_t candidates[BLOCK_BYTES / 64];
+
+        auto kernel = get_compare_kernel<uint8_t>(compare_op::equal);
+
+        for (size_t block = 0; block < size; block += BLOCK_BYTES) {
+            size_t count = std::min(BLOCK_BYTES, size - block);
+            size_t words = (count + 63) / 64;
+
+            std::fill(candidates, candidates + words, 0);
+
+            for (auto value : _first_bytes) {
+                kernel(data + block, count, value, value, mask);
+
+                for (size_t word = 0; word < words; word++)
+                    candidates[word] |= mask[word];
+            }
+
+            for (size_t word = 0; word < words; word++) {
+                uint64_t bits = candidates[word];
+
+                while (bits) {
+                    check(data, size, block + word * 64 + std::countr_zero(bits), base, out);
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+    else {
+        for (size_t position = 0; position + 1 < size; position++) {
+            uint16_t key = static_cast<uint16_t>(data[position] | (data[position + 1] << 8));
+
+            if (_pair_filter[key / 64] & (1ull << (key % 64)))
+                check(data, size, position, base, out);
+        }
+
+        // The last byte has no pair, only single byte anchors can start there.
+        check(data, size, size - 1, base, out);
+    }
+
+    // Anchors sit at different offsets, restore the address order.
+    std::sort(out.begin() + first_match, out.end(), [](const signature_match& lhs, const signature_match& rhs) {
+        return lhs.address != rhs.address ? lhs.address < rhs.address : lhs.signature < rhs.signature;
+    });
+}
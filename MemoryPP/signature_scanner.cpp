@@ -0,0 +1,25 @@
+#include "signature_scanner.hpp"
+
+
+std::optional<size_t> signature_scanner::add(std::string_view pattern)
+{
+    auto parsed = signature::parse(pattern);
+
+    if (!parsed)
+        return std::nullopt;
+
+    return _signatures.add(std::move(*parsed));
+}
+
+std::vector<signature_match> signature_scanner::scan(const std::pair<void*, void*>& range, uint32_t protection_flags)
+{
+    if (_signatures.size() == 0)
+        return {};
+
+    auto regions = get_regions(range, protection_flags);
+
+    return search_regions<signature_match>(regions, _signatures.max_size() - 1,
+        [this](const uint8_t* data, size_t size, uint64_t base, std::vector<signature_match>& out) {
+            _signatures.search(data, size, base, out);
+        });
+}
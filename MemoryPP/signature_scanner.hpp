@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string_view>
+#include "scan_engine.hpp"
+#include "signature/signature.hpp"
+
+// Searches byte signatures over the regions of a process. All the added signatures are searched together,
+// each region is read once however many there are.
+class signature_scanner : public scan_engine
+{
+    signature_set _signatures;
+
+public:
+    signature_scanner(long process_id, std::shared_ptr<thread_pool> pool = nullptr) : scan_engine(process_id, std::move(pool)) {}
+    signature_scanner(std::shared_ptr<process_access> access, std::shared_ptr<thread_pool> pool = nullptr) : scan_engine(std::move(access), std::move(pool)) {}
+    virtual ~signature_scanner() override = default;
+
+    // Parses and adds a pattern, see signature::parse. Returns its index, or nothing when it is malformed.
+    std::optional<size_t> add(std::string_view pattern);
+
+    __forceinline const signature_set& signatures() const { return _signatures; }
+
+    // Matches of every signature in the regions with any of protection_flags, ordered by address.
+    std::vector<signature_match> scan(const std::pair<void*, void*>& range, uint32_t protection_flags = protection_read);
+};
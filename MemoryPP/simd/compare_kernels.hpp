@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Relation evaluated by a comparison kernel. between is exclusive on both ends.
+enum class compare_op : uint8_t {
+    equal,
+    less,
+    greater,
+    between
+};
+
+// Compares count values against low (and high for between) and writes one bit per value to mask,
+// bit i of mask[i / 64] is set when data[i] matches. The mask needs (count + 63) / 64 words.
+// data does not need to be aligned to T.
+template <typename T>
+using compare_kernel = void(*)(const T* data, size_t count, T low, T high, uint64_t* mask);
+
+template <typename T>
+inline constexpr bool has_compare_kernels =
+    std::is_same_v<T, int8_t> || std::is_same_v<T, uint8_t> ||
+    std::is_same_v<T, int16_t> || std::is_same_v<T, uint16_t> ||
+    std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t> ||
+    std::is_same_v<T, int64_t> || std::is_same_v<T, uint64_t> ||
+    std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+// A kernel bound to its operands.
+template <typename T>
+struct compare_predicate {
+    compare_kernel<T> kernel{ nullptr };
+    T low{};
+    T high{};
+};
+
+// Returns the fastest kernel for op supported by the running CPU.
+template <typename T>
+compare_kernel<T> get_compare_kernel(compare_op op);
+
+// Per instruction set kernels, selected by get_compare_kernel.
+template <typename T> compare_kernel<T> scalar_compare_kernel(compare_op op);
+template <typename T> compare_kernel<T> sse2_compare_kernel(compare_op op);
+template <typename T> compare_kernel<T> avx2_compare_kernel(compare_op op);
+template <typename T> compare_kernel<T> avx512_compare_kernel(compare_op op);
+
+// Relation between a new and an old value evaluated by a diff kernel.
+// The _by forms compare the wrapped difference against an operand.
+enum class diff_op : uint8_t {
+    changed,
+    unchanged,
+    increased,
+    decreased,
+    increased_by,
+    decreased_by
+};
+
+// Compares new_data[i] against old_data[i] for count values, the mask is laid out as for compare_kernel.
+template <typename T>
+using diff_kernel = void(*)(const T* old_data, const T* new_data, size_t count, T operand, uint64_t* mask);
+
+// A diff kernel bound to its operand.
+template <typename T>
+struct diff_predicate {
+    diff_kernel<T> kernel{ nullptr };
+    T operand{};
+};
+
+// Returns the fastest kernel for op supported by the running CPU.
+template <typename T>
+diff_kernel<T> get_diff_kernel(diff_op op);
+
+// Per instruction set kernels, selected by get_diff_kernel.
+template <typename T> diff_kernel<T> scalar_diff_kernel(diff_op op);
+template <typename T> diff_kernel<T> sse2_diff_kernel(diff_op op);
+template <typename T> diff_kernel<T> avx2_diff_kernel(diff_op op);
+template <typename T> diff_kernel<T> avx512_diff_kernel(diff_op op);
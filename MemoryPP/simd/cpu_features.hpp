@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+
+// Instruction set tiers used by the vectorized kernels, ordered from the slowest one.
+enum class simd_level : uint8_t {
+    scalar,
+    sse2,
+    avx2,
+    avx512
+};
+
+// Highest tier supported by the running CPU and operating system.
+simd_level detect_simd_level();
+
+// Tier used by the kernels: the detected one, unless lowered with set_max_simd_level.
+simd_level max_simd_level();
+
+// Caps the tier used by the kernels, mainly to compare or validate the code paths.
+void set_max_simd_level(simd_level level);
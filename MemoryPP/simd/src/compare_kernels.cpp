@@ -0,0 +1,44 @@
+#include "../compare_kernels.hpp"
+#include "../cpu_features.hpp"
+#include "../../platform.hpp"
+#include <cstring>
+#include "compare_kernels_impl.hpp"
+
+template <typename T>
+compare_kernel<T> scalar_compare_kernel(compare_op op)
+{
+    return scalar_kernel<T>(op);
+}
+
+template <typename T>
+compare_kernel<T> get_compare_kernel(compare_op op)
+{
+    switch (max_simd_level()) {
+    case simd_level::avx512: return avx512_compare_kernel<T>(op);
+    case simd_level::avx2:   return avx2_compare_kernel<T>(op);
+    case simd_level::sse2:   return sse2_compare_kernel<T>(op);
+    default:                 return scalar_compare_kernel<T>(op);
+    }
+}
+
+template <typename T>
+diff_kernel<T> scalar_diff_kernel(diff_op op)
+{
+    return scalar_kernel<T>(op);
+}
+
+template <typename T>
+diff_kernel<T> get_diff_kernel(diff_op op)
+{
+    switch (max_simd_level()) {
+    case simd_level::avx512: return avx512_diff_kernel<T>(op);
+    case simd_level::avx2:   return avx2_diff_kernel<T>(op);
+    case simd_level::sse2:   return sse2_diff_kernel<T>(op);
+    default:                 return scalar_diff_kernel<T>(op);
+    }
+}
+
+INSTANTIATE_COMPARE_KERNELS(scalar_compare_kernel)
+INSTANTIATE_COMPARE_KERNELS(get_compare_kernel)
+INSTANTIATE_DIFF_KERNELS(scalar_diff_kernel)
+INSTANTIATE_DIFF_KERNELS(get_diff_kernel)
@@ -0,0 +1,167 @@
+#include "../compare_kernels.hpp"
+#include "../../platform.hpp"
+#include <climits>
+#include <cstring>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+#include "compare_kernels_impl.hpp"
+
+namespace {
+
+struct avx2_int8 {
+    using vec = __m256i;
+    static constexpr size_t lanes = 32;
+
+    static __forceinline vec set1(int8_t value) { return _mm256_set1_epi8(value); }
+    static __forceinline vec load(const int8_t* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+    static __forceinline vec flip(vec v) { return _mm256_xor_si256(v, _mm256_set1_epi8(INT8_MIN)); }
+    static __forceinline vec eq(vec a, vec b) { return _mm256_cmpeq_epi8(a, b); }
+    static __forceinline vec lt(vec a, vec b) { return _mm256_cmpgt_epi8(b, a); }
+    static __forceinline vec gt(vec a, vec b) { return _mm256_cmpgt_epi8(a, b); }
+    static __forceinline vec both(vec a, vec b) { return _mm256_and_si256(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm256_sub_epi8(a, b); }
+    static __forceinline uint64_t bits(vec m) { return static_cast<uint32_t>(_mm256_movemask_epi8(m)); }
+};
+
+struct avx2_int16 {
+    using vec = __m256i;
+    static constexpr size_t lanes = 16;
+
+    static __forceinline vec set1(int16_t value) { return _mm256_set1_epi16(value); }
+    static __forceinline vec load(const int16_t* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+    static __forceinline vec flip(vec v) { return _mm256_xor_si256(v, _mm256_set1_epi16(INT16_MIN)); }
+    static __forceinline vec eq(vec a, vec b) { return _mm256_cmpeq_epi16(a, b); }
+    static __forceinline vec lt(vec a, vec b) { return _mm256_cmpgt_epi16(b, a); }
+    static __forceinline vec gt(vec a, vec b) { return _mm256_cmpgt_epi16(a, b); }
+    static __forceinline vec both(vec a, vec b) { return _mm256_and_si256(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm256_sub_epi16(a, b); }
+
+    // Narrow the 16-bit lanes to bytes, the two 128-bit halves keep the element order.
+    static __forceinline uint64_t bits(vec m) {
+        auto packed = _mm_packs_epi16(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+        return static_cast<uint32_t>(_mm_movemask_epi8(packed));
+    }
+};
+
+struct avx2_int32 {
+    using vec = __m256i;
+    static constexpr size_t lanes = 8;
+
+    static __forceinline vec set1(int32_t value) { return _mm256_set1_epi32(value); }
+    static __forceinline vec load(const int32_t* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+    static __forceinline vec flip(vec v) { return _mm256_xor_si256(v, _mm256_set1_epi32(INT32_MIN)); }
+    static __forceinline vec eq(vec a, vec b) { return _mm256_cmpeq_epi32(a, b); }
+    static __forceinline vec lt(vec a, vec b) { return _mm256_cmpgt_epi32(b, a); }
+    static __forceinline vec gt(vec a, vec b) { return _mm256_cmpgt_epi32(a, b); }
+    static __forceinline vec both(vec a, vec b) { return _mm256_and_si256(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm256_sub_epi32(a, b); }
+    static __forceinline uint64_t bits(vec m) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(m))); }
+};
+
+struct avx2_int64 {
+    using vec = __m256i;
+    static constexpr size_t lanes = 4;
+
+    static __forceinline vec set1(int64_t value) { return _mm256_set1_epi64x(value); }
+    static __forceinline vec load(const int64_t* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+    static __forceinline vec flip(vec v) { return _mm256_xor_si256(v, _mm256_set1_epi64x(INT64_MIN)); }
+    static __forceinline vec eq(vec a, vec b) { return _mm256_cmpeq_epi64(a, b); }
+    static __forceinline vec lt(vec a, vec b) { return _mm256_cmpgt_epi64(b, a); }
+    static __forceinline vec gt(vec a, vec b) { return _mm256_cmpgt_epi64(a, b); }
+    static __forceinline vec both(vec a, vec b) { return _mm256_and_si256(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm256_sub_epi64(a, b); }
+    static __forceinline uint64_t bits(vec m) { return static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(m))); }
+};
+
+struct avx2_float {
+    using vec = __m256;
+    static constexpr size_t lanes = 8;
+
+    static __forceinline vec set1(float value) { return _mm256_set1_ps(value); }
+    static __forceinline vec load(const float* data) { return _mm256_loadu_ps(data); }
+    static __forceinline vec eq(vec a, vec b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static __forceinline vec lt(vec a, vec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static __forceinline vec gt(vec a, vec b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static __forceinline vec both(vec a, vec b) { return _mm256_and_ps(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm256_sub_ps(a, b); }
+    static __forceinline uint64_t bits(vec m) { return static_cast<uint32_t>(_mm256_movemask_ps(m)); }
+};
+
+struct avx2_double {
+    using vec = __m256d;
+    static constexpr size_t lanes = 4;
+
+    static __forceinline vec set1(double value) { return _mm256_set1_pd(value); }
+    static __forceinline vec load(const double* data) { return _mm256_loadu_pd(data); }
+    static __forceinline vec eq(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    static __forceinline vec lt(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static __forceinline vec gt(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static __forceinline vec both(vec a, vec b) { return _mm256_and_pd(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm256_sub_pd(a, b); }
+    static __forceinline uint64_t bits(vec m) { return static_cast<uint32_t>(_mm256_movemask_pd(m)); }
+};
+
+template <typename T> struct avx2_ops;
+template <> struct avx2_ops<int8_t> : avx2_int8 {};
+template <> struct avx2_ops<uint8_t> : unsigned_ops<avx2_int8, uint8_t, int8_t> {};
+template <> struct avx2_ops<int16_t> : avx2_int16 {};
+template <> struct avx2_ops<uint16_t> : unsigned_ops<avx2_int16, uint16_t, int16_t> {};
+template <> struct avx2_ops<int32_t> : avx2_int32 {};
+template <> struct avx2_ops<uint32_t> : unsigned_ops<avx2_int32, uint32_t, int32_t> {};
+template <> struct avx2_ops<int64_t> : avx2_int64 {};
+template <> struct avx2_ops<uint64_t> : unsigned_ops<avx2_int64, uint64_t, int64_t> {};
+template <> struct avx2_ops<float> : avx2_float {};
+template <> struct avx2_ops<double> : avx2_double {};
+
+}
+
+template <typename T>
+compare_kernel<T> avx2_compare_kernel(compare_op op)
+{
+    return vector_kernel<avx2_ops<T>, T>(op);
+}
+
+INSTANTIATE_COMPARE_KERNELS(avx2_compare_kernel)
+
+template <typename T>
+diff_kernel<T> avx2_diff_kernel(diff_op op)
+{
+    return vector_kernel<avx2_ops<T>, T>(op);
+}
+
+INSTANTIATE_DIFF_KERNELS(avx2_diff_kernel)
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#else
+
+#include "compare_kernels_impl.hpp"
+
+template <typename T>
+compare_kernel<T> avx2_compare_kernel(compare_op op)
+{
+    return scalar_compare_kernel<T>(op);
+}
+
+INSTANTIATE_COMPARE_KERNELS(avx2_compare_kernel)
+
+template <typename T>
+diff_kernel<T> avx2_diff_kernel(diff_op op)
+{
+    return scalar_diff_kernel<T>(op);
+}
+
+INSTANTIATE_DIFF_KERNELS(avx2_diff_kernel)
+
+#endif
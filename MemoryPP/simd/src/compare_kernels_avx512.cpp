@@ -0,0 +1,170 @@
+#include "../compare_kernels.hpp"
+#include "../../platform.hpp"
+#include <climits>
+#include <cstring>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,avx512bw"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f,avx512bw")
+#endif
+
+#include <immintrin.h>
+#include "compare_kernels_impl.hpp"
+
+namespace {
+
+// AVX-512 compares write straight into mask registers, bits() only widens them.
+
+struct avx512_int8 {
+    using vec = __m512i;
+    using mask = __mmask64;
+    static constexpr size_t lanes = 64;
+
+    static __forceinline vec set1(int8_t value) { return _mm512_set1_epi8(value); }
+    static __forceinline vec load(const int8_t* data) { return _mm512_loadu_si512(data); }
+    static __forceinline vec flip(vec v) { return _mm512_xor_si512(v, _mm512_set1_epi8(INT8_MIN)); }
+    static __forceinline mask eq(vec a, vec b) { return _mm512_cmpeq_epi8_mask(a, b); }
+    static __forceinline mask lt(vec a, vec b) { return _mm512_cmplt_epi8_mask(a, b); }
+    static __forceinline mask gt(vec a, vec b) { return _mm512_cmpgt_epi8_mask(a, b); }
+    static __forceinline mask both(mask a, mask b) { return a & b; }
+    static __forceinline vec sub(vec a, vec b) { return _mm512_sub_epi8(a, b); }
+    static __forceinline uint64_t bits(mask m) { return static_cast<uint64_t>(m); }
+};
+
+struct avx512_int16 {
+    using vec = __m512i;
+    using mask = __mmask32;
+    static constexpr size_t lanes = 32;
+
+    static __forceinline vec set1(int16_t value) { return _mm512_set1_epi16(value); }
+    static __forceinline vec load(const int16_t* data) { return _mm512_loadu_si512(data); }
+    static __forceinline vec flip(vec v) { return _mm512_xor_si512(v, _mm512_set1_epi16(INT16_MIN)); }
+    static __forceinline mask eq(vec a, vec b) { return _mm512_cmpeq_epi16_mask(a, b); }
+    static __forceinline mask lt(vec a, vec b) { return _mm512_cmplt_epi16_mask(a, b); }
+    static __forceinline mask gt(vec a, vec b) { return _mm512_cmpgt_epi16_mask(a, b); }
+    static __forceinline mask both(mask a, mask b) { return a & b; }
+    static __forceinline vec sub(vec a, vec b) { return _mm512_sub_epi16(a, b); }
+    static __forceinline uint64_t bits(mask m) { return static_cast<uint64_t>(m); }
+};
+
+struct avx512_int32 {
+    using vec = __m512i;
+    using mask = __mmask16;
+    static constexpr size_t lanes = 16;
+
+    static __forceinline vec set1(int32_t value) { return _mm512_set1_epi32(value); }
+    static __forceinline vec load(const int32_t* data) { return _mm512_loadu_si512(data); }
+    static __forceinline vec flip(vec v) { return _mm512_xor_si512(v, _mm512_set1_epi32(INT32_MIN)); }
+    static __forceinline mask eq(vec a, vec b) { return _mm512_cmpeq_epi32_mask(a, b); }
+    static __forceinline mask lt(vec a, vec b) { return _mm512_cmplt_epi32_mask(a, b); }
+    static __forceinline mask gt(vec a, vec b) { return _mm512_cmpgt_epi32_mask(a, b); }
+    static __forceinline mask both(mask a, mask b) { return a & b; }
+    static __forceinline vec sub(vec a, vec b) { return _mm512_sub_epi32(a, b); }
+    static __forceinline uint64_t bits(mask m) { return static_cast<uint64_t>(m); }
+};
+
+struct avx512_int64 {
+    using vec = __m512i;
+    using mask = __mmask8;
+    static constexpr size_t lanes = 8;
+
+    static __forceinline vec set1(int64_t value) { return _mm512_set1_epi64(value); }
+    static __forceinline vec load(const int64_t* data) { return _mm512_loadu_si512(data); }
+    static __forceinline vec flip(vec v) { return _mm512_xor_si512(v, _mm512_set1_epi64(INT64_MIN)); }
+    static __forceinline mask eq(vec a, vec b) { return _mm512_cmpeq_epi64_mask(a, b); }
+    static __forceinline mask lt(vec a, vec b) { return _mm512_cmplt_epi64_mask(a, b); }
+    static __forceinline mask gt(vec a, vec b) { return _mm512_cmpgt_epi64_mask(a, b); }
+    static __forceinline mask both(mask a, mask b) { return a & b; }
+    static __forceinline vec sub(vec a, vec b) { return _mm512_sub_epi64(a, b); }
+    static __forceinline uint64_t bits(mask m) { return static_cast<uint64_t>(m); }
+};
+
+struct avx512_float {
+    using vec = __m512;
+    using mask = __mmask16;
+    static constexpr size_t lanes = 16;
+
+    static __forceinline vec set1(float value) { return _mm512_set1_ps(value); }
+    static __forceinline vec load(const float* data) { return _mm512_loadu_ps(data); }
+    static __forceinline mask eq(vec a, vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static __forceinline mask lt(vec a, vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static __forceinline mask gt(vec a, vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static __forceinline mask both(mask a, mask b) { return a & b; }
+    static __forceinline vec sub(vec a, vec b) { return _mm512_sub_ps(a, b); }
+    static __forceinline uint64_t bits(mask m) { return static_cast<uint64_t>(m); }
+};
+
+struct avx512_double {
+    using vec = __m512d;
+    using mask = __mmask8;
+    static constexpr size_t lanes = 8;
+
+    static __forceinline vec set1(double value) { return _mm512_set1_pd(value); }
+    static __forceinline vec load(const double* data) { return _mm512_loadu_pd(data); }
+    static __forceinline mask eq(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+    static __forceinline mask lt(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static __forceinline mask gt(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    static __forceinline mask both(mask a, mask b) { return a & b; }
+    static __forceinline vec sub(vec a, vec b) { return _mm512_sub_pd(a, b); }
+    static __forceinline uint64_t bits(mask m) { return static_cast<uint64_t>(m); }
+};
+
+template <typename T> struct avx512_ops;
+template <> struct avx512_ops<int8_t> : avx512_int8 {};
+template <> struct avx512_ops<uint8_t> : unsigned_ops<avx512_int8, uint8_t, int8_t> {};
+template <> struct avx512_ops<int16_t> : avx512_int16 {};
+template <> struct avx512_ops<uint16_t> : unsigned_ops<avx512_int16, uint16_t, int16_t> {};
+template <> struct avx512_ops<int32_t> : avx512_int32 {};
+template <> struct avx512_ops<uint32_t> : unsigned_ops<avx512_int32, uint32_t, int32_t> {};
+template <> struct avx512_ops<int64_t> : avx512_int64 {};
+template <> struct avx512_ops<uint64_t> : unsigned_ops<avx512_int64, uint64_t, int64_t> {};
+template <> struct avx512_ops<float> : avx512_float {};
+template <> struct avx512_ops<double> : avx512_double {};
+
+}
+
+template <typename T>
+compare_kernel<T> avx512_compare_kernel(compare_op op)
+{
+    return vector_kernel<avx512_ops<T>, T>(op);
+}
+
+INSTANTIATE_COMPARE_KERNELS(avx512_compare_kernel)
+
+template <typename T>
+diff_kernel<T> avx512_diff_kernel(diff_op op)
+{
+    return vector_kernel<avx512_ops<T>, T>(op);
+}
+
+INSTANTIATE_DIFF_KERNELS(avx512_diff_kernel)
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#else
+
+#include "compare_kernels_impl.hpp"
+
+template <typename T>
+compare_kernel<T> avx512_compare_kernel(compare_op op)
+{
+    return scalar_compare_kernel<T>(op);
+}
+
+INSTANTIATE_COMPARE_KERNELS(avx512_compare_kernel)
+
+template <typename T>
+diff_kernel<T> avx512_diff_kernel(diff_op op)
+{
+    return scalar_diff_kernel<T>(op);
+}
+
+INSTANTIATE_DIFF_KERNELS(avx512_diff_kernel)
+
+#endif
@@ -0,0 +1,237 @@
+#pragma once
+// Shared body of the comparison kernels. Each instruction set unit includes this header after
+// selecting its target, everything here has internal linkage so code built for one instruction
+// set can never be picked by the linker for another unit.
+
+namespace {
+
+// Unaligned scans hand in pointers at any byte offset, scalar code reads through memcpy
+// so the compiler never assumes the natural alignment of T.
+template <typename T>
+__forceinline T load_value(const T* data) {
+    T value;
+    std::memcpy(&value, static_cast<const void*>(data), sizeof(T));
+    return value;
+}
+
+template <compare_op Op, typename T>
+__forceinline bool scalar_match(T value, T low, T high) {
+    if constexpr (Op == compare_op::equal)
+        return value == low;
+    else if constexpr (Op == compare_op::less)
+        return value < low;
+    else if constexpr (Op == compare_op::greater)
+        return value > low;
+    else
+        return value > low && value < high;
+}
+
+template <compare_op Op, typename T>
+void scalar_compare(const T* data, size_t count, T low, T high, uint64_t* mask) {
+    for (size_t word = 0; word * 64 < count; word++) {
+        const T* values = data + word * 64;
+        size_t remaining = count - word * 64;
+        size_t lanes = remaining < 64 ? remaining : 64;
+        uint64_t bits = 0;
+
+        for (size_t j = 0; j < lanes; j++)
+            bits |= static_cast<uint64_t>(scalar_match<Op>(load_value(values + j), low, high)) << j;
+
+        mask[word] = bits;
+    }
+}
+
+// Ops provides, for one element type and instruction set:
+//   lanes                      elements per vector
+//   set1(T), load(const T*)    broadcast and unaligned load
+//   eq, lt, gt(vec, vec)       lane masks, both(mask, mask) intersects two of them
+//   sub(vec, vec)              wrapping lane difference, in the same encoding as set1
+//   bits(mask)                 one bit per lane, lane 0 in bit 0
+template <typename Ops, compare_op Op, typename T>
+void vector_compare(const T* data, size_t count, T low, T high, uint64_t* mask) {
+    const auto low_vector = Ops::set1(low);
+    const auto high_vector = Ops::set1(high);
+
+    size_t words = count / 64;
+
+    for (size_t word = 0; word < words; word++) {
+        const T* values = data + word * 64;
+        uint64_t bits = 0;
+
+        for (size_t j = 0; j < 64; j += Ops::lanes) {
+            auto vector = Ops::load(values + j);
+            uint64_t lanes_matched;
+
+            if constexpr (Op == compare_op::equal)
+                lanes_matched = Ops::bits(Ops::eq(vector, low_vector));
+            else if constexpr (Op == compare_op::less)
+                lanes_matched = Ops::bits(Ops::lt(vector, low_vector));
+            else if constexpr (Op == compare_op::greater)
+                lanes_matched = Ops::bits(Ops::gt(vector, low_vector));
+            else
+                lanes_matched = Ops::bits(Ops::both(Ops::gt(vector, low_vector), Ops::lt(vector, high_vector)));
+
+            bits |= lanes_matched << j;
+        }
+
+        mask[word] = bits;
+    }
+
+    if (count % 64)
+        scalar_compare<Op>(data + words * 64, count - words * 64, low, high, mask + words);
+}
+
+template <diff_op Op, typename T>
+__forceinline bool scalar_diff_match(T old_value, T new_value, T operand) {
+    if constexpr (Op == diff_op::changed)
+        return new_value != old_value;
+    else if constexpr (Op == diff_op::unchanged)
+        return new_value == old_value;
+    else if constexpr (Op == diff_op::increased)
+        return new_value > old_value;
+    else if constexpr (Op == diff_op::decreased)
+        return new_value < old_value;
+    else if constexpr (Op == diff_op::increased_by)
+        return static_cast<T>(new_value - old_value) == operand;
+    else
+        return static_cast<T>(old_value - new_value) == operand;
+}
+
+template <diff_op Op, typename T>
+void scalar_diff(const T* old_data, const T* new_data, size_t count, T operand, uint64_t* mask) {
+    for (size_t word = 0; word * 64 < count; word++) {
+        size_t first = word * 64;
+        size_t remaining = count - first;
+        size_t lanes = remaining < 64 ? remaining : 64;
+        uint64_t bits = 0;
+
+        for (size_t j = 0; j < lanes; j++)
+            bits |= static_cast<uint64_t>(scalar_diff_match<Op>(load_value(old_data + first + j), load_value(new_data + first + j), operand)) << j;
+
+        mask[word] = bits;
+    }
+}
+
+template <typename Ops, diff_op Op, typename T>
+void vector_diff(const T* old_data, const T* new_data, size_t count, T operand, uint64_t* mask) {
+    const auto operand_vector = Ops::set1(operand);
+
+    size_t words = count / 64;
+
+    for (size_t word = 0; word < words; word++) {
+        const T* old_values = old_data + word * 64;
+        const T* new_values = new_data + word * 64;
+        uint64_t bits = 0;
+
+        for (size_t j = 0; j < 64; j += Ops::lanes) {
+            auto old_vector = Ops::load(old_values + j);
+            auto new_vector = Ops::load(new_values + j);
+            uint64_t lanes_matched;
+
+            if constexpr (Op == diff_op::changed || Op == diff_op::unchanged)
+                lanes_matched = Ops::bits(Ops::eq(new_vector, old_vector));
+            else if constexpr (Op == diff_op::increased)
+                lanes_matched = Ops::bits(Ops::gt(new_vector, old_vector));
+            else if constexpr (Op == diff_op::decreased)
+                lanes_matched = Ops::bits(Ops::lt(new_vector, old_vector));
+            else if constexpr (Op == diff_op::increased_by)
+                lanes_matched = Ops::bits(Ops::eq(Ops::sub(new_vector, old_vector), operand_vector));
+            else
+                lanes_matched = Ops::bits(Ops::eq(Ops::sub(old_vector, new_vector), operand_vector));
+
+            bits |= lanes_matched << j;
+        }
+
+        // changed is the complement of equal, NaN lanes compare unequal to themselves as in scalar code.
+        if constexpr (Op == diff_op::changed)
+            bits = ~bits;
+
+        mask[word] = bits;
+    }
+
+    if (count % 64)
+        scalar_diff<Op>(old_data + words * 64, new_data + words * 64, count - words * 64, operand, mask + words);
+}
+
+// Unsigned lanes are compared with the signed instructions after flipping the sign bit.
+// The difference of two flipped values is the plain difference, it is flipped again to match set1.
+template <typename Ops, typename U, typename S>
+struct unsigned_ops : Ops {
+    static __forceinline typename Ops::vec set1(U value) { return Ops::flip(Ops::set1(static_cast<S>(value))); }
+    static __forceinline typename Ops::vec load(const U* data) { return Ops::flip(Ops::load(reinterpret_cast<const S*>(data))); }
+    static __forceinline typename Ops::vec sub(typename Ops::vec a, typename Ops::vec b) { return Ops::flip(Ops::sub(a, b)); }
+};
+
+template <typename T>
+compare_kernel<T> scalar_kernel(compare_op op) {
+    switch (op) {
+    case compare_op::equal:   return &scalar_compare<compare_op::equal, T>;
+    case compare_op::less:    return &scalar_compare<compare_op::less, T>;
+    case compare_op::greater: return &scalar_compare<compare_op::greater, T>;
+    case compare_op::between: return &scalar_compare<compare_op::between, T>;
+    default:                  return nullptr;
+    }
+}
+
+template <typename Ops, typename T>
+compare_kernel<T> vector_kernel(compare_op op) {
+    switch (op) {
+    case compare_op::equal:   return &vector_compare<Ops, compare_op::equal, T>;
+    case compare_op::less:    return &vector_compare<Ops, compare_op::less, T>;
+    case compare_op::greater: return &vector_compare<Ops, compare_op::greater, T>;
+    case compare_op::between: return &vector_compare<Ops, compare_op::between, T>;
+    default:                  return nullptr;
+    }
+}
+
+template <typename T>
+diff_kernel<T> scalar_kernel(diff_op op) {
+    switch (op) {
+    case diff_op::changed:      return &scalar_diff<diff_op::changed, T>;
+    case diff_op::unchanged:    return &scalar_diff<diff_op::unchanged, T>;
+    case diff_op::increased:    return &scalar_diff<diff_op::increased, T>;
+    case diff_op::decreased:    return &scalar_diff<diff_op::decreased, T>;
+    case diff_op::increased_by: return &scalar_diff<diff_op::increased_by, T>;
+    case diff_op::decreased_by: return &scalar_diff<diff_op::decreased_by, T>;
+    default:                    return nullptr;
+    }
+}
+
+template <typename Ops, typename T>
+diff_kernel<T> vector_kernel(diff_op op) {
+    switch (op) {
+    case diff_op::changed:      return &vector_diff<Ops, diff_op::changed, T>;
+    case diff_op::unchanged:    return &vector_diff<Ops, diff_op::unchanged, T>;
+    case diff_op::increased:    return &vector_diff<Ops, diff_op::increased, T>;
+    case diff_op::decreased:    return &vector_diff<Ops, diff_op::decreased, T>;
+    case diff_op::increased_by: return &vector_diff<Ops, diff_op::increased_by, T>;
+    case diff_op::decreased_by: return &vector_diff<Ops, diff_op::decreased_by, T>;
+    default:                    return nullptr;
+    }
+}
+
+}
+
+#define INSTANTIATE_COMPARE_KERNELS(name) \
+    template compare_kernel<int8_t> name<int8_t>(compare_op); \
+    template compare_kernel<uint8_t> name<uint8_t>(compare_op); \
+    template compare_kernel<int16_t> name<int16_t>(compare_op); \
+    template compare_kernel<uint16_t> name<uint16_t>(compare_op); \
+    template compare_kernel<int32_t> name<int32_t>(compare_op); \
+    template compare_kernel<uint32_t> name<uint32_t>(compare_op); \
+    template compare_kernel<int64_t> name<int64_t>(compare_op); \
+    template compare_kernel<uint64_t> name<uint64_t>(compare_op); \
+    template compare_kernel<float> name<float>(compare_op); \
+    template compare_kernel<double> name<double>(compare_op);
+
+#define INSTANTIATE_DIFF_KERNELS(name) \
+    template diff_kernel<int8_t> name<int8_t>(diff_op); \
+    template diff_kernel<uint8_t> name<uint8_t>(diff_op); \
+    template diff_kernel<int16_t> name<int16_t>(diff_op); \
+    template diff_kernel<uint16_t> name<uint16_t>(diff_op); \
+    template diff_kernel<int32_t> name<int32_t>(diff_op); \
+    template diff_kernel<uint32_t> name<uint32_t>(diff_op); \
+    template diff_kernel<int64_t> name<int64_t>(diff_op); \
+    template diff_kernel<uint64_t> name<uint64_t>(diff_op); \
+    template diff_kernel<float> name<float>(diff_op); \
+    template diff_kernel<double> name<double>(diff_op);
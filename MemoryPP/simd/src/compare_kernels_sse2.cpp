@@ -0,0 +1,152 @@
+#include "../compare_kernels.hpp"
+#include "../../platform.hpp"
+#include <climits>
+#include <cstring>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("sse2")
+#endif
+
+#include <emmintrin.h>
+#include "compare_kernels_impl.hpp"
+
+namespace {
+
+struct sse2_int8 {
+    using vec = __m128i;
+    static constexpr size_t lanes = 16;
+
+    static __forceinline vec set1(int8_t value) { return _mm_set1_epi8(value); }
+    static __forceinline vec load(const int8_t* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+    static __forceinline vec flip(vec v) { return _mm_xor_si128(v, _mm_set1_epi8(INT8_MIN)); }
+    static __forceinline vec eq(vec a, vec b) { return _mm_cmpeq_epi8(a, b); }
+    static __forceinline vec lt(vec a, vec b) { return _mm_cmplt_epi8(a, b); }
+    static __forceinline vec gt(vec a, vec b) { return _mm_cmpgt_epi8(a, b); }
+    static __forceinline vec both(vec a, vec b) { return _mm_and_si128(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm_sub_epi8(a, b); }
+    static __forceinline uint64_t bits(vec m) { return static_cast<uint32_t>(_mm_movemask_epi8(m)); }
+};
+
+struct sse2_int16 {
+    using vec = __m128i;
+    static constexpr size_t lanes = 8;
+
+    static __forceinline vec set1(int16_t value) { return _mm_set1_epi16(value); }
+    static __forceinline vec load(const int16_t* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+    static __forceinline vec flip(vec v) { return _mm_xor_si128(v, _mm_set1_epi16(INT16_MIN)); }
+    static __forceinline vec eq(vec a, vec b) { return _mm_cmpeq_epi16(a, b); }
+    static __forceinline vec lt(vec a, vec b) { return _mm_cmplt_epi16(a, b); }
+    static __forceinline vec gt(vec a, vec b) { return _mm_cmpgt_epi16(a, b); }
+    static __forceinline vec both(vec a, vec b) { return _mm_and_si128(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm_sub_epi16(a, b); }
+    static __forceinline uint64_t bits(vec m) { return static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(m, _mm_setzero_si128()))); }
+};
+
+struct sse2_int32 {
+    using vec = __m128i;
+    static constexpr size_t lanes = 4;
+
+    static __forceinline vec set1(int32_t value) { return _mm_set1_epi32(value); }
+    static __forceinline vec load(const int32_t* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+    static __forceinline vec flip(vec v) { return _mm_xor_si128(v, _mm_set1_epi32(INT32_MIN)); }
+    static __forceinline vec eq(vec a, vec b) { return _mm_cmpeq_epi32(a, b); }
+    static __forceinline vec lt(vec a, vec b) { return _mm_cmplt_epi32(a, b); }
+    static __forceinline vec gt(vec a, vec b) { return _mm_cmpgt_epi32(a, b); }
+    static __forceinline vec both(vec a, vec b) { return _mm_and_si128(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm_sub_epi32(a, b); }
+    static __forceinline uint64_t bits(vec m) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(m))); }
+};
+
+struct sse2_float {
+    using vec = __m128;
+    static constexpr size_t lanes = 4;
+
+    static __forceinline vec set1(float value) { return _mm_set1_ps(value); }
+    static __forceinline vec load(const float* data) { return _mm_loadu_ps(data); }
+    static __forceinline vec eq(vec a, vec b) { return _mm_cmpeq_ps(a, b); }
+    static __forceinline vec lt(vec a, vec b) { return _mm_cmplt_ps(a, b); }
+    static __forceinline vec gt(vec a, vec b) { return _mm_cmpgt_ps(a, b); }
+    static __forceinline vec both(vec a, vec b) { return _mm_and_ps(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm_sub_ps(a, b); }
+    static __forceinline uint64_t bits(vec m) { return static_cast<uint32_t>(_mm_movemask_ps(m)); }
+};
+
+struct sse2_double {
+    using vec = __m128d;
+    static constexpr size_t lanes = 2;
+
+    static __forceinline vec set1(double value) { return _mm_set1_pd(value); }
+    static __forceinline vec load(const double* data) { return _mm_loadu_pd(data); }
+    static __forceinline vec eq(vec a, vec b) { return _mm_cmpeq_pd(a, b); }
+    static __forceinline vec lt(vec a, vec b) { return _mm_cmplt_pd(a, b); }
+    static __forceinline vec gt(vec a, vec b) { return _mm_cmpgt_pd(a, b); }
+    static __forceinline vec both(vec a, vec b) { return _mm_and_pd(a, b); }
+    static __forceinline vec sub(vec a, vec b) { return _mm_sub_pd(a, b); }
+    static __forceinline uint64_t bits(vec m) { return static_cast<uint32_t>(_mm_movemask_pd(m)); }
+};
+
+template <typename T> struct sse2_ops;
+template <> struct sse2_ops<int8_t> : sse2_int8 {};
+template <> struct sse2_ops<uint8_t> : unsigned_ops<sse2_int8, uint8_t, int8_t> {};
+template <> struct sse2_ops<int16_t> : sse2_int16 {};
+template <> struct sse2_ops<uint16_t> : unsigned_ops<sse2_int16, uint16_t, int16_t> {};
+template <> struct sse2_ops<int32_t> : sse2_int32 {};
+template <> struct sse2_ops<uint32_t> : unsigned_ops<sse2_int32, uint32_t, int32_t> {};
+template <> struct sse2_ops<float> : sse2_float {};
+template <> struct sse2_ops<double> : sse2_double {};
+
+}
+
+template <typename T>
+compare_kernel<T> sse2_compare_kernel(compare_op op)
+{
+    // SSE2 has no 64-bit integer compare, those stay on the scalar kernel.
+    if constexpr (std::is_integral_v<T> && sizeof(T) == 8)
+        return scalar_kernel<T>(op);
+    else
+        return vector_kernel<sse2_ops<T>, T>(op);
+}
+
+INSTANTIATE_COMPARE_KERNELS(sse2_compare_kernel)
+
+template <typename T>
+diff_kernel<T> sse2_diff_kernel(diff_op op)
+{
+    if constexpr (std::is_integral_v<T> && sizeof(T) == 8)
+        return scalar_kernel<T>(op);
+    else
+        return vector_kernel<sse2_ops<T>, T>(op);
+}
+
+INSTANTIATE_DIFF_KERNELS(sse2_diff_kernel)
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#else
+
+#include "compare_kernels_impl.hpp"
+
+template <typename T>
+compare_kernel<T> sse2_compare_kernel(compare_op op)
+{
+    return scalar_compare_kernel<T>(op);
+}
+
+INSTANTIATE_COMPARE_KERNELS(sse2_compare_kernel)
+
+template <typename T>
+diff_kernel<T> sse2_diff_kernel(diff_op op)
+{
+    return scalar_diff_kernel<T>(op);
+}
+
+INSTANTIATE_DIFF_KERNELS(sse2_diff_kernel)
+
+#endif
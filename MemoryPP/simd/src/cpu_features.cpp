@@ -0,0 +1,88 @@
+#include "../cpu_features.hpp"
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+static std::atomic<simd_level> _max_level{ simd_level::avx512 };
+
+#ifdef SIMD_X86
+static void query_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4]) {
+#if defined(_MSC_VER)
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; i++)
+        registers[i] = static_cast<uint32_t>(values[i]);
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+static uint64_t query_xcr0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax = 0, edx = 0;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+simd_level detect_simd_level() {
+#ifdef SIMD_X86
+    uint32_t registers[4] = {};
+
+    query_cpuid(0, 0, registers);
+    uint32_t max_leaf = registers[0];
+
+    query_cpuid(1, 0, registers);
+    bool sse2 = (registers[3] & (1u << 26)) != 0;
+    bool osxsave = (registers[2] & (1u << 27)) != 0;
+    bool avx = (registers[2] & (1u << 28)) != 0;
+
+    if (!sse2)
+        return simd_level::scalar;
+
+    if (!osxsave || !avx || max_leaf < 7)
+        return simd_level::sse2;
+
+    // The OS has to save the YMM (and ZMM / opmask) state on context switches.
+    uint64_t xcr0 = query_xcr0();
+    bool ymm_state = (xcr0 & 0x6) == 0x6;
+    bool zmm_state = (xcr0 & 0xE6) == 0xE6;
+
+    query_cpuid(7, 0, registers);
+    bool avx2 = (registers[1] & (1u << 5)) != 0;
+    bool avx512f = (registers[1] & (1u << 16)) != 0;
+    bool avx512bw = (registers[1] & (1u << 30)) != 0;
+
+    if (avx512f && avx512bw && zmm_state)
+        return simd_level::avx512;
+
+    if (avx2 && ymm_state)
+        return simd_level::avx2;
+
+    return simd_level::sse2;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+simd_level max_simd_level() {
+    static const simd_level detected = detect_simd_level();
+
+    auto cap = _max_level.load(std::memory_order_relaxed);
+    return cap < detected ? cap : detected;
+}
+
+void set_max_simd_level(simd_level level) {
+    _max_level.store(level, std::memory_order_relaxed);
+}
@@ -0,0 +1,74 @@
+#include "string_scanner.hpp"
+
+
+std::vector<text_match> string_scanner::first_scan(std::queue<std::shared_ptr<memory_region>>& regions, const text_pattern& pattern)
+{
+    return search_regions<text_match>(regions, pattern.size() - 1,
+        [&pattern](const uint8_t* data, size_t size, uint64_t base, std::vector<text_match>& out) {
+            pattern.search(data, size, base, out);
+        });
+}
+
+std::vector<text_match> string_scanner::next_scan(const text_pattern& pattern)
+{
+    size_t tasks = (_prev_matches.size() + MATCHES_PER_TASK - 1) / MATCHES_PER_TASK;
+    std::vector<std::vector<text_match>> parts(tasks);
+
+    if (_access) {
+        task_group group(*_pool);
+
+        for (size_t task = 0; task < tasks; task++) {
+            group.run([&, task]() {
+                size_t first = task * MATCHES_PER_TASK;
+                size_t count = std::min(MATCHES_PER_TASK, _prev_matches.size() - first);
+                size_t size = pattern.size();
+
+                std::vector<uint8_t> buffer(count * size);
+                std::vector<read_request> requests(count);
+
+                for (size_t k = 0; k < count; k++)
+                    requests[k] = { _prev_matches[first + k].address, buffer.data() + k * size, size };
+
+                _access->read_batch(requests);
+
+                for (size_t k = 0; k < count; k++) {
+                    if (requests[k].bytes_read == size && pattern.matches(buffer.data() + k * size))
+                        parts[task].push_back({ requests[k].address, static_cast<uint32_t>(size) });
+                }
+            });
+        }
+
+        group.wait();
+    }
+
+    std::vector<text_match> matches;
+
+    for (auto& part : parts)
+        matches.insert(matches.end(), part.begin(), part.end());
+
+    return matches;
+}
+
+size_t string_scanner::scan(const std::pair<void*, void*>& range, std::string_view text, text_encoding encoding, bool case_insensitive, uint32_t protection_flags)
+{
+    auto pattern = text_pattern::compile(text, encoding, case_insensitive);
+
+    if (!pattern)
+        return 0;
+
+    if (_current_scan == 0) {
+        auto regions = get_regions(range, protection_flags);
+        _prev_matches = first_scan(regions, *pattern);
+        _current_scan = 1;
+    }
+    else {
+        auto begin = reinterpret_cast<uint64_t>(range.first);
+        auto end = reinterpret_cast<uint64_t>(range.second);
+
+        std::erase_if(_prev_matches, [&](const text_match& match) { return match.address < begin || match.address >= end; });
+
+        _prev_matches = next_scan(*pattern);
+    }
+
+    return _prev_matches.size();
+}
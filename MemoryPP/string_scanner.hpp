@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string_view>
+#include "scan_engine.hpp"
+#include "text/text_pattern.hpp"
+
+// Searches text over the regions of a process. The first scan reads every region, the following
+// ones only read back the bytes at the previous matches.
+class string_scanner : public scan_engine
+{
+    // Matches re-checked by a single task of a next scan, read with one batched call.
+    static constexpr size_t MATCHES_PER_TASK = 4096;
+
+    std::vector<text_match> _prev_matches;
+
+    std::vector<text_match> first_scan(std::queue<std::shared_ptr<memory_region>>& regions, const text_pattern& pattern);
+    std::vector<text_match> next_scan(const text_pattern& pattern);
+
+public:
+    string_scanner(long process_id, std::shared_ptr<thread_pool> pool = nullptr) : scan_engine(process_id, std::move(pool)) {}
+    string_scanner(std::shared_ptr<process_access> access, std::shared_ptr<thread_pool> pool = nullptr) : scan_engine(std::move(access), std::move(pool)) {}
+    virtual ~string_scanner() override = default;
+
+    // text is UTF-8 and is searched in the given encoding, see text_pattern::compile.
+    // protection_flags only applies to the first scan. Returns the number of matches, 0 when text is malformed.
+    size_t scan(const std::pair<void*, void*>& range, std::string_view text, text_encoding encoding, bool case_insensitive = false,
+        uint32_t protection_flags = protection_read);
+
+    __forceinline const std::vector<text_match>& get_results() const { return _prev_matches; }
+};
@@ -0,0 +1,230 @@
+#include "test_check.hpp"
+#include "../simd/compare_kernels.hpp"
+#include "../simd/cpu_features.hpp"
+#include "../scan_engine.hpp"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Every vectorized kernel the CPU supports must set the same mask bits as the scalar kernel, for any count,
+// any byte offset of the data and the edge values of each type.
+
+file_dump memory_dump("compare_kernels_test_dump.bin");
+file_dump results("compare_kernels_test_results.bin");
+
+namespace {
+
+constexpr size_t COUNTS[] = { 0, 1, 7, 63, 64, 65, 127, 200, 1000, 4099 };
+constexpr size_t OFFSETS[] = { 0, 1, 3 };
+constexpr int ROUNDS = 8;
+
+const char* level_name(simd_level level)
+{
+    switch (level) {
+    case simd_level::sse2:   return "sse2";
+    case simd_level::avx2:   return "avx2";
+    case simd_level::avx512: return "avx512";
+    default:                 return "scalar";
+    }
+}
+
+// Values the kernels treat specially: the extremes of T, around zero and, for floating point, NaN and infinities.
+template<typename T>
+std::vector<T> edge_values()
+{
+    using limits = std::numeric_limits<T>;
+
+    std::vector<T> values = { T(0), T(1), T(2), static_cast<T>(-1), static_cast<T>(-2), limits::min(), limits::max(), limits::lowest() };
+
+    if constexpr (std::is_floating_point_v<T>) {
+        values.push_back(limits::quiet_NaN());
+        values.push_back(limits::infinity());
+        values.push_back(-limits::infinity());
+        values.push_back(-T(0));
+        values.push_back(limits::denorm_min());
+        values.push_back(T(0.5));
+    }
+    else {
+        values.push_back(static_cast<T>(limits::max() - 1));
+        values.push_back(static_cast<T>(limits::min() + 1));
+    }
+
+    return values;
+}
+
+// Mostly small values so every relation matches often, some edge values mixed in.
+template<typename T>
+T random_value(std::mt19937_64& rng, const std::vector<T>& edges)
+{
+    if (rng() % 4 == 0)
+        return edges[rng() % edges.size()];
+
+    return static_cast<T>(static_cast<int>(rng() % 9) - 4);
+}
+
+// Copies values to a buffer at a byte offset, the kernels read data at any alignment.
+template<typename T>
+const T* place(std::vector<uint8_t>& storage, const std::vector<T>& values, size_t offset)
+{
+    storage.assign(values.size() * sizeof(T) + offset + 1, 0);
+
+    if (!values.empty())
+        std::memcpy(storage.data() + offset, values.data(), values.size() * sizeof(T));
+
+    return reinterpret_cast<const T*>(storage.data() + offset);
+}
+
+bool same_bits(const std::vector<uint64_t>& lhs, const std::vector<uint64_t>& rhs, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (((lhs[i / 64] >> (i % 64)) & 1) != ((rhs[i / 64] >> (i % 64)) & 1))
+            return false;
+    }
+    return true;
+}
+
+template<typename T>
+compare_kernel<T> compare_kernel_at(simd_level level, compare_op op)
+{
+    switch (level) {
+    case simd_level::sse2:   return sse2_compare_kernel<T>(op);
+    case simd_level::avx2:   return avx2_compare_kernel<T>(op);
+    case simd_level::avx512: return avx512_compare_kernel<T>(op);
+    default:                 return scalar_compare_kernel<T>(op);
+    }
+}
+
+template<typename T>
+diff_kernel<T> diff_kernel_at(simd_level level, diff_op op)
+{
+    switch (level) {
+    case simd_level::sse2:   return sse2_diff_kernel<T>(op);
+    case simd_level::avx2:   return avx2_diff_kernel<T>(op);
+    case simd_level::avx512: return avx512_diff_kernel<T>(op);
+    default:                 return scalar_diff_kernel<T>(op);
+    }
+}
+
+template<typename T>
+void test_compare(const char* type_name, simd_level level, std::mt19937_64& rng)
+{
+    constexpr compare_op OPS[] = { compare_op::equal, compare_op::less, compare_op::greater, compare_op::between };
+    auto edges = edge_values<T>();
+    std::vector<uint8_t> storage;
+
+    for (auto op : OPS) {
+        auto scalar = scalar_compare_kernel<T>(op);
+        auto vector = compare_kernel_at<T>(level, op);
+
+        for (size_t count : COUNTS) {
+            for (size_t offset : OFFSETS) {
+                for (int round = 0; round < ROUNDS; round++) {
+                    std::vector<T> values(count);
+
+                    for (auto& value : values)
+                        value = random_value(rng, edges);
+
+                    T low = random_value(rng, edges);
+                    T high = random_value(rng, edges);
+                    const T* data = place(storage, values, offset);
+
+                    std::vector<uint64_t> expected((count + 63) / 64 + 1, 0);
+                    std::vector<uint64_t> actual((count + 63) / 64 + 1, 0);
+
+                    scalar(data, count, low, high, expected.data());
+                    vector(data, count, low, high, actual.data());
+
+                    if (!check(same_bits(expected, actual, count), "compare %s %s op %d count %zu offset %zu",
+                        level_name(level), type_name, static_cast<int>(op), count, offset))
+                        return;
+                }
+            }
+        }
+    }
+}
+
+template<typename T>
+void test_diff(const char* type_name, simd_level level, std::mt19937_64& rng)
+{
+    constexpr diff_op OPS[] = { diff_op::changed, diff_op::unchanged, diff_op::increased, diff_op::decreased, diff_op::increased_by, diff_op::decreased_by };
+    auto edges = edge_values<T>();
+    std::vector<uint8_t> old_storage;
+    std::vector<uint8_t> new_storage;
+
+    for (auto op : OPS) {
+        auto scalar = scalar_diff_kernel<T>(op);
+        auto vector = diff_kernel_at<T>(level, op);
+
+        for (size_t count : COUNTS) {
+            for (size_t offset : OFFSETS) {
+                for (int round = 0; round < ROUNDS; round++) {
+                    std::vector<T> old_values(count);
+                    std::vector<T> new_values(count);
+
+                    // Half the values are kept, the others move by a small step or anywhere.
+                    for (size_t i = 0; i < count; i++) {
+                        old_values[i] = random_value(rng, edges);
+
+                        switch (rng() % 4) {
+                        case 0:
+                        case 1:  new_values[i] = old_values[i]; break;
+                        case 2:  new_values[i] = static_cast<T>(old_values[i] + static_cast<T>(rng() % 3)); break;
+                        default: new_values[i] = random_value(rng, edges); break;
+                        }
+                    }
+
+                    T operand = static_cast<T>(rng() % 3);
+                    const T* old_data = place(old_storage, old_values, offset);
+                    const T* new_data = place(new_storage, new_values, offset);
+
+                    std::vector<uint64_t> expected((count + 63) / 64 + 1, 0);
+                    std::vector<uint64_t> actual((count + 63) / 64 + 1, 0);
+
+                    scalar(old_data, new_data, count, operand, expected.data());
+                    vector(old_data, new_data, count, operand, actual.data());
+
+                    if (!check(same_bits(expected, actual, count), "diff %s %s op %d count %zu offset %zu",
+                        level_name(level), type_name, static_cast<int>(op), count, offset))
+                        return;
+                }
+            }
+        }
+    }
+}
+
+template<typename T>
+void test_type(const char* type_name, simd_level level, std::mt19937_64& rng)
+{
+    test_compare<T>(type_name, level, rng);
+    test_diff<T>(type_name, level, rng);
+}
+
+}
+
+int main()
+{
+    std::mt19937_64 rng(20261016);
+    auto detected = detect_simd_level();
+
+    for (auto level : { simd_level::sse2, simd_level::avx2, simd_level::avx512 }) {
+        if (level > detected) {
+            std::printf("%s: not supported by this CPU, skipped\n", level_name(level));
+            continue;
+        }
+
+        test_type<int8_t>("int8", level, rng);
+        test_type<uint8_t>("uint8", level, rng);
+        test_type<int16_t>("int16", level, rng);
+        test_type<uint16_t>("uint16", level, rng);
+        test_type<int32_t>("int32", level, rng);
+        test_type<uint32_t>("uint32", level, rng);
+        test_type<int64_t>("int64", level, rng);
+        test_type<uint64_t>("uint64", level, rng);
+        test_type<float>("float", level, rng);
+        test_type<double>("double", level, rng);
+    }
+
+    return check_summary("compare_kernels_test");
+}
@@ -0,0 +1,209 @@
+#include "test_check.hpp"
+#include "../scan_engine.hpp"
+
+// Reads, modules, page population and write tracking of process_access against a forked child that owns a known mapping.
+
+file_dump memory_dump("process_access_test_dump.bin");
+file_dump results("process_access_test_results.bin");
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace {
+
+constexpr size_t PAGE = process_access::TRACKING_PAGE_BYTES;
+constexpr size_t PAGES = 16;
+constexpr size_t FILLED_PAGES = 8;
+
+// The child writes the pages named by the parent, one byte per page index, and answers each with a byte.
+// Index 0xFF ends it.
+[[noreturn]] void run_child(uint8_t* block, int commands, int replies)
+{
+    for (size_t i = 0; i < FILLED_PAGES * PAGE; i++)
+        block[i] = static_cast<uint8_t>(i * 7 + 1);
+
+    uint8_t page = 0;
+    ::write(replies, &page, 1);
+
+    while (::read(commands, &page, 1) == 1 && page != 0xFF) {
+        std::memset(block + page * PAGE + 100, 0xAB, 16);
+        ::write(replies, &page, 1);
+    }
+
+    _exit(0);
+}
+
+bool has_bit(const std::vector<uint64_t>& bits, size_t index)
+{
+    return index / 64 < bits.size() && ((bits[index / 64] >> (index % 64)) & 1);
+}
+
+void test_regions(process_access& access, uint64_t base)
+{
+    auto regions = access.query_regions(base, base + PAGES * PAGE);
+
+    if (!check(regions.size() == 1, "query_regions returned %zu regions for the mapping", regions.size()))
+        return;
+
+    check(regions[0].base == base && regions[0].size == PAGES * PAGE, "region covers the mapping");
+    check((regions[0].protection & protection_read) && (regions[0].protection & protection_write), "region is readable and writable");
+    check(regions[0].state == region_state::committed, "region is committed");
+    check(regions[0].kind == region_kind::private_memory, "region is private memory");
+}
+
+// The child runs this executable, its code lies in the module named after it.
+void test_modules(process_access& access)
+{
+    auto modules = access.query_modules();
+    auto code = reinterpret_cast<uint64_t>(&run_child);
+
+    char path[4096] = {};
+    ::readlink("/proc/self/exe", path, sizeof(path) - 1);
+    std::string name = std::strrchr(path, '/') ? std::strrchr(path, '/') + 1 : path;
+
+    const module_info* holder = nullptr;
+
+    for (auto& loaded : modules) {
+        if (code >= loaded.base && code - loaded.base < loaded.size)
+            holder = &loaded;
+    }
+
+    if (check(holder != nullptr, "a module holds the code of the child"))
+        check(holder->name == name, "module %s is named after the executable", holder->name.c_str());
+
+    for (size_t i = 1; i < modules.size(); i++)
+        check(modules[i - 1].base < modules[i].base, "modules are sorted by base");
+}
+
+void test_populated(process_access& access, uint64_t base)
+{
+    std::vector<uint64_t> populated;
+
+    if (!access.query_populated_pages(base, PAGES * PAGE, populated)) {
+        std::printf("query_populated_pages: not supported, skipped\n");
+        return;
+    }
+
+    for (size_t page = 0; page < PAGES; page++)
+        check(has_bit(populated, page) == (page < FILLED_PAGES), "populated bit of page %zu", page);
+}
+
+void test_reads(process_access& access, uint64_t base, const uint8_t* expected)
+{
+    std::vector<uint8_t> buffer(PAGES * PAGE, 0xCC);
+    size_t bytes_read = 0;
+
+    check(access.read(base, buffer.data(), buffer.size(), &bytes_read), "read of the whole mapping");
+    check(bytes_read == buffer.size(), "read returned %zu bytes", bytes_read);
+    check(std::memcmp(buffer.data(), expected, buffer.size()) == 0, "read content matches the child");
+
+    // Unaligned and crossing a page boundary.
+    std::vector<uint8_t> small(PAGE + 13);
+    check(access.read(base + PAGE - 5, small.data(), small.size(), &bytes_read), "unaligned read");
+    check(std::memcmp(small.data(), expected + PAGE - 5, small.size()) == 0, "unaligned read content");
+
+    // The guard page behind the mapping is not readable, the batch reports it and still reads the others.
+    std::vector<uint8_t> first(100), second(PAGE), third(64);
+    read_request requests[] = {
+        { base + 3, first.data(), first.size() },
+        { base + PAGES * PAGE, third.data(), third.size() },
+        { base + 9 * PAGE, second.data(), second.size() },
+    };
+
+    size_t completed = access.read_batch(requests);
+
+    check(completed == 2, "read_batch completed %zu of 3 requests", completed);
+    check(requests[0].bytes_read == first.size() && std::memcmp(first.data(), expected + 3, first.size()) == 0, "first batch request");
+    check(requests[1].bytes_read == 0, "unmapped batch request read %zu bytes", requests[1].bytes_read);
+    check(requests[2].bytes_read == second.size() && std::memcmp(second.data(), expected + 9 * PAGE, second.size()) == 0, "third batch request");
+}
+
+void test_written(process_access& access, uint64_t base, int commands, int replies)
+{
+    if (!access.reset_written_pages()) {
+        std::printf("write tracking: not supported by this kernel, skipped\n");
+        return;
+    }
+
+    for (uint8_t page : { uint8_t(3), uint8_t(12) }) {
+        uint8_t reply = 0;
+        ::write(commands, &page, 1);
+        ::read(replies, &reply, 1);
+    }
+
+    std::vector<uint64_t> written;
+
+    if (!check(access.query_written_pages(base, PAGES * PAGE, written), "query_written_pages after a reset"))
+        return;
+
+    for (size_t page = 0; page < PAGES; page++)
+        check(has_bit(written, page) == (page == 3 || page == 12), "written bit of page %zu", page);
+}
+
+}
+
+int main()
+{
+    std::setvbuf(stdout, nullptr, _IONBF, 0);
+
+    // A guard page follows the mapping so reads past its end fail.
+    auto* area = static_cast<uint8_t*>(mmap(nullptr, (PAGES + 1) * PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (area == MAP_FAILED || mprotect(area + PAGES * PAGE, PAGE, PROT_NONE) != 0) {
+        std::printf("mmap failed\n");
+        return 1;
+    }
+
+    int commands[2], replies[2];
+    if (pipe(commands) != 0 || pipe(replies) != 0) {
+        std::printf("pipe failed\n");
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        ::close(commands[1]);
+        ::close(replies[0]);
+        run_child(area, commands[0], replies[1]);
+    }
+
+    ::close(commands[0]);
+    ::close(replies[1]);
+
+    uint8_t ready = 0;
+    ::read(replies[0], &ready, 1);
+
+    // The parent's copy of the mapping was never written, build the content the child holds.
+    std::vector<uint8_t> expected(PAGES * PAGE, 0);
+    for (size_t i = 0; i < FILLED_PAGES * PAGE; i++)
+        expected[i] = static_cast<uint8_t>(i * 7 + 1);
+
+    auto access = process_access::open(child);
+    uint64_t base = reinterpret_cast<uint64_t>(area);
+
+    if (check(access != nullptr, "process_access::open of the child")) {
+        test_regions(*access, base);
+        test_modules(*access);
+        test_populated(*access, base);
+        test_reads(*access, base, expected.data());
+        test_written(*access, base, commands[1], replies[0]);
+    }
+
+    uint8_t stop = 0xFF;
+    ::write(commands[1], &stop, 1);
+    waitpid(child, nullptr, 0);
+
+    return check_summary("process_access_test");
+}
+
+#else
+
+int main()
+{
+    std::printf("process_access_test: only implemented for Linux, skipped\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,419 @@
+#include "test_check.hpp"
+#include "../scan_engine.hpp"
+#include "../scan_engine_multi.hpp"
+#include "../simd/cpu_features.hpp"
+
+// Scan sequences of both engines against a reference computed element by element from reads of the same memory.
+// The child holds a dense region larger than a read batch, streamed in chunks, a sparse region mostly made of
+// untouched pages and many small regions, so streamed, sparse and batched reads and every result encoding are hit.
+
+file_dump memory_dump("scan_engine_test_dump.bin");
+file_dump results("scan_engine_test_results.bin");
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace {
+
+constexpr size_t PAGE = 4096;
+// Larger than the 16 MB read batch of the engine, so it is streamed.
+constexpr size_t DENSE_BYTES = 24 * 1024 * 1024;
+constexpr size_t SPARSE_BYTES = 32 * 1024 * 1024;
+constexpr size_t SPARSE_FILLED_EVERY = 64;
+constexpr size_t SMALL_REGIONS = 256;
+constexpr size_t SMALL_BYTES = 2 * PAGE;
+
+// Regions are separated by inaccessible guard pages of the reserved range.
+constexpr size_t DENSE_OFFSET = 0;
+constexpr size_t SPARSE_OFFSET = DENSE_OFFSET + DENSE_BYTES + PAGE;
+constexpr size_t SMALL_OFFSET = SPARSE_OFFSET + SPARSE_BYTES + PAGE;
+constexpr size_t SMALL_SPACING = SMALL_BYTES + PAGE;
+constexpr size_t RESERVED_BYTES = SMALL_OFFSET + SMALL_REGIONS * SMALL_SPACING;
+
+struct area {
+    size_t offset;
+    size_t size;
+};
+
+std::vector<area> areas()
+{
+    std::vector<area> list = { { DENSE_OFFSET, DENSE_BYTES }, { SPARSE_OFFSET, SPARSE_BYTES } };
+
+    for (size_t i = 0; i < SMALL_REGIONS; i++)
+        list.push_back({ SMALL_OFFSET + i * SMALL_SPACING, SMALL_BYTES });
+
+    return list;
+}
+
+// Small values, so exact scans for 7 find plenty.
+uint8_t pattern(size_t index, size_t seed)
+{
+    return static_cast<uint8_t>((static_cast<uint32_t>(index * 2654435761u + seed * 40503u) >> 28) & 0xF);
+}
+
+void write_int(uint8_t* at, int32_t value)
+{
+    std::memcpy(at, &value, sizeof(value));
+}
+
+void fill(uint8_t* base)
+{
+    for (size_t i = 0; i < DENSE_BYTES; i += 4)
+        write_int(base + DENSE_OFFSET + i, pattern(i, 0));
+
+    // Unaligned values only a stride of 1 finds.
+    for (size_t i = 4099; i + 4 <= DENSE_BYTES; i += 4099 * 3)
+        write_int(base + DENSE_OFFSET + i, 7);
+
+    for (size_t page = 0; page < SPARSE_BYTES / PAGE; page += SPARSE_FILLED_EVERY) {
+        for (size_t i = 0; i < PAGE; i += 4)
+            write_int(base + SPARSE_OFFSET + page * PAGE + i, pattern(i + page, 1));
+    }
+
+    for (auto [offset, size] : areas()) {
+        if (offset < SMALL_OFFSET)
+            continue;
+
+        for (size_t i = 0; i < size; i += 4)
+            write_int(base + offset + i, pattern(i + offset, 2));
+    }
+}
+
+// Changes scattered bytes, up and down, and writes pages of the sparse region that were never touched.
+void mutate(uint8_t* base, size_t step)
+{
+    for (size_t i = step * 37; i < DENSE_BYTES; i += 4093)
+        base[DENSE_OFFSET + i] = pattern(i, step + 10);
+
+    for (size_t page = step + 1; page < SPARSE_BYTES / PAGE; page += SPARSE_FILLED_EVERY * 3)
+        base[SPARSE_OFFSET + page * PAGE + (page * 13) % PAGE] = 7;
+
+    for (size_t i = step % 5; i < SMALL_REGIONS; i += 5) {
+        size_t offset = SMALL_OFFSET + i * SMALL_SPACING;
+        for (size_t j = step * 4; j < SMALL_BYTES; j += 509)
+            base[offset + j] = pattern(j + i, step + 20);
+    }
+}
+
+// The child fills its regions, then mutates them once per byte read from commands.
+[[noreturn]] void run_child(int commands, int replies)
+{
+    auto* base = static_cast<uint8_t*>(mmap(nullptr, RESERVED_BYTES, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+
+    if (base == MAP_FAILED)
+        _exit(1);
+
+    for (auto [offset, size] : areas())
+        mprotect(base + offset, size, PROT_READ | PROT_WRITE);
+
+    fill(base);
+    ::write(replies, &base, sizeof(base));
+
+    uint8_t step = 0;
+    while (::read(commands, &step, 1) == 1) {
+        mutate(base, step);
+        ::write(replies, &step, 1);
+    }
+
+    _exit(0);
+}
+
+struct scan_step {
+    scan_type type;
+    int32_t value;
+    bool mutate_before;
+};
+
+struct engine_config {
+    const char* name;
+    bool compression;
+    bool page_hashing;
+    bool skip_unpopulated;
+    bool write_tracking;
+};
+
+// Expected results of a sequence, from reads of the whole regions before each scan.
+class reference {
+    process_access& _access;
+    uint64_t _base;
+    size_t _stride;
+    std::vector<uint8_t> _previous;
+    std::vector<uint8_t> _current;
+    std::vector<bool> _candidates;
+
+public:
+    reference(process_access& access, uint64_t base, size_t stride) : _access(access), _base(base), _stride(stride) {}
+
+    void read()
+    {
+        _previous.swap(_current);
+        _current.assign(RESERVED_BYTES, 0);
+
+        for (auto [offset, size] : areas()) {
+            size_t bytes_read = 0;
+            check(_access.read(_base + offset, _current.data() + offset, size, &bytes_read), "reference read at offset %zx", offset);
+        }
+    }
+
+    int32_t current_at(size_t offset) const
+    {
+        int32_t value;
+        std::memcpy(&value, _current.data() + offset, sizeof(value));
+        return value;
+    }
+
+    int32_t previous_at(size_t offset) const
+    {
+        int32_t value;
+        std::memcpy(&value, _previous.data() + offset, sizeof(value));
+        return value;
+    }
+
+    bool matches(const scan_step& step, size_t offset) const
+    {
+        int32_t value = current_at(offset);
+
+        switch (step.type) {
+        case scan_type::unknown_value:   return true;
+        case scan_type::exact_value:     return value == step.value;
+        case scan_type::changed:         return value != previous_at(offset);
+        case scan_type::unchanged:       return value == previous_at(offset);
+        case scan_type::decreased_value: return value < previous_at(offset);
+        case scan_type::increased_value: return value > previous_at(offset);
+        default:                         return false;
+        }
+    }
+
+    void apply(const scan_step& step, bool first)
+    {
+        if (first)
+            _candidates.assign(RESERVED_BYTES, false);
+
+        for (auto [offset, size] : areas()) {
+            for (size_t i = offset; i + sizeof(int32_t) <= offset + size; i += _stride) {
+                if (first || _candidates[i])
+                    _candidates[i] = matches(step, i);
+            }
+        }
+    }
+
+    size_t count() const
+    {
+        size_t total = 0;
+
+        for (size_t i = 0; i < RESERVED_BYTES; i++)
+            total += _candidates[i];
+
+        return total;
+    }
+
+    // Compares the addresses and the values held by the engine with the reference.
+    void compare(const std::vector<std::pair<uint64_t, int32_t>>& found, const char* context)
+    {
+        std::vector<bool> seen(RESERVED_BYTES, false);
+        size_t expected = count();
+        size_t wrong_values = 0;
+        size_t outside = 0;
+        size_t duplicates = 0;
+
+        for (auto [address, value] : found) {
+            if (address < _base || address - _base >= RESERVED_BYTES || !_candidates[address - _base]) {
+                if (outside++ == 0)
+                    std::printf("  unexpected result at offset %llx\n", static_cast<unsigned long long>(address - _base));
+                continue;
+            }
+
+            size_t offset = static_cast<size_t>(address - _base);
+            duplicates += seen[offset];
+            seen[offset] = true;
+
+            if (value != current_at(offset) && wrong_values++ == 0)
+                std::printf("  value at offset %zx is %d, expected %d\n", offset, value, current_at(offset));
+        }
+
+        size_t missing = 0;
+        for (size_t i = 0; i < RESERVED_BYTES; i++) {
+            if (_candidates[i] && !seen[i] && missing++ == 0)
+                std::printf("  missing result at offset %zx\n", i);
+        }
+
+        check(outside == 0 && missing == 0 && duplicates == 0 && wrong_values == 0,
+            "%s: %zu results, expected %zu (%zu unexpected, %zu missing, %zu duplicates, %zu wrong values)",
+            context, found.size(), expected, outside, missing, duplicates, wrong_values);
+    }
+};
+
+template<typename Results>
+void collect(const Results& results, std::vector<std::pair<uint64_t, int32_t>>& found)
+{
+    found.clear();
+
+    if (!results)
+        return;
+
+    results->for_each([&](int32_t, const auto& result) {
+        result->for_each_element([&](int32_t value, uint64_t address) { found.emplace_back(address, value); });
+    });
+}
+
+void configure(scan_engine& engine, const engine_config& config, size_t stride)
+{
+    engine.set_alignment(stride);
+    engine.set_snapshot_compression(config.compression);
+    engine.set_page_hashing(config.page_hashing);
+    engine.set_skip_unpopulated(config.skip_unpopulated);
+    engine.set_write_tracking(config.write_tracking);
+}
+
+class target {
+    pid_t _child{ -1 };
+    int _commands{ -1 };
+    int _replies{ -1 };
+    uint8_t _step{ 0 };
+
+public:
+    uint64_t base{ 0 };
+    std::shared_ptr<process_access> access;
+
+    target()
+    {
+        int commands[2], replies[2];
+        if (pipe(commands) != 0 || pipe(replies) != 0)
+            return;
+
+        _child = fork();
+        if (_child == 0) {
+            ::close(commands[1]);
+            ::close(replies[0]);
+            run_child(commands[0], replies[1]);
+        }
+
+        // The child ends once the last write end of commands is closed.
+        ::close(commands[0]);
+        ::close(replies[1]);
+        _commands = commands[1];
+        _replies = replies[0];
+
+        uint8_t* child_base = nullptr;
+        if (::read(_replies, &child_base, sizeof(child_base)) == sizeof(child_base)) {
+            base = reinterpret_cast<uint64_t>(child_base);
+            access = process_access::open(_child);
+        }
+    }
+
+    ~target()
+    {
+        if (_child <= 0)
+            return;
+
+        ::close(_commands);
+        waitpid(_child, nullptr, 0);
+    }
+
+    void mutate()
+    {
+        uint8_t reply = 0;
+        ::write(_commands, &_step, 1);
+        ::read(_replies, &reply, 1);
+        _step++;
+    }
+};
+
+void run_sequence(target& process, std::shared_ptr<thread_pool> pool, const std::vector<scan_step>& steps,
+    const engine_config& config, size_t stride, bool multi)
+{
+    reference expected(*process.access, process.base, stride);
+    std::pair<void*, void*> range{ reinterpret_cast<void*>(process.base), reinterpret_cast<void*>(process.base + RESERVED_BYTES) };
+    std::vector<std::pair<uint64_t, int32_t>> found;
+
+    scan_engine_templated<int32_t> templated(process.access, pool);
+    scan_engine_multi<int32_t> multiple(process.access, pool);
+    scan_engine& engine = multi ? static_cast<scan_engine&>(multiple) : templated;
+    configure(engine, config, stride);
+
+    for (size_t i = 0; i < steps.size(); i++) {
+        const auto& step = steps[i];
+
+        if (step.mutate_before)
+            process.mutate();
+
+        expected.read();
+        expected.apply(step, i == 0);
+
+        size_t count = 0;
+
+        if (multi) {
+            count = multiple.scan(range, step.type, step.value);
+            collect(multiple.get_results<int32_t>(), found);
+        }
+        else {
+            count = templated.scan(range, step.type, step.value);
+            collect(templated.get_results(), found);
+        }
+
+        char context[160];
+        std::snprintf(context, sizeof(context), "%s engine, %s, stride %zu, simd %d, step %zu (type %d)",
+            multi ? "multi" : "templated", config.name, stride, static_cast<int>(max_simd_level()), i, static_cast<int>(step.type));
+
+        // An unknown_value scan only keeps a snapshot, its elements are neither counted nor listed.
+        if (step.type == scan_type::unknown_value)
+            continue;
+
+        check(count == expected.count(), "%s: scan counted %zu, expected %zu", context, count, expected.count());
+        expected.compare(found, context);
+    }
+}
+
+}
+
+int main()
+{
+    std::setvbuf(stdout, nullptr, _IONBF, 0);
+
+    target process;
+    if (!check(process.access != nullptr, "starting the child"))
+        return check_summary("scan_engine_test");
+
+    auto pool = std::make_shared<thread_pool>(4);
+
+    const std::vector<std::vector<scan_step>> sequences = {
+        { { scan_type::exact_value, 7, false }, { scan_type::exact_value, 7, true }, { scan_type::unchanged, 0, true } },
+        { { scan_type::unknown_value, 0, false }, { scan_type::changed, 0, true }, { scan_type::decreased_value, 0, true }, { scan_type::unchanged, 0, true } },
+    };
+
+    const engine_config configs[] = {
+        { "defaults", true, true, true, false },
+        { "plain snapshots", false, false, false, false },
+        { "write tracking", true, true, true, true },
+    };
+
+    auto detected = detect_simd_level();
+
+    for (auto level : { detected, simd_level::scalar }) {
+        set_max_simd_level(level);
+
+        for (const auto& config : configs) {
+            for (size_t stride : { size_t(4), size_t(1), size_t(8) }) {
+                for (bool multi : { false, true }) {
+                    for (const auto& steps : sequences)
+                        run_sequence(process, pool, steps, config, stride, multi);
+                }
+            }
+        }
+    }
+
+    return check_summary("scan_engine_test");
+}
+
+#else
+
+int main()
+{
+    std::printf("scan_engine_test: only implemented for Linux, skipped\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdarg>
+#include <cstdio>
+
+// Checks of the test programs. Every test is a program of its own built with the MemoryPP sources but main.cpp,
+// a failed check is reported and counted, main returns the count.
+inline int check_failures = 0;
+
+inline bool check(bool ok, const char* format, ...)
+{
+    if (ok)
+        return true;
+
+    va_list args;
+    va_start(args, format);
+    std::printf("FAILED: ");
+    std::vprintf(format, args);
+    std::printf("\n");
+    va_end(args);
+
+    check_failures++;
+    return false;
+}
+
+inline int check_summary(const char* name)
+{
+    if (check_failures)
+        std::printf("%s: %d checks failed\n", name, check_failures);
+    else
+        std::printf("%s: passed\n", name);
+
+    return check_failures;
+}
@@ -0,0 +1,161 @@
+#include "../text_pattern.hpp"
+#include "../../simd/compare_kernels.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+// Decodes the next code point of UTF-8 text, false on a malformed sequence.
+bool next_code_point(std::string_view text, size_t& i, uint32_t& code_point) {
+    uint8_t lead = static_cast<uint8_t>(text[i]);
+    size_t length;
+
+    if (lead < 0x80) {
+        code_point = lead;
+        length = 1;
+    }
+    else if ((lead & 0xE0) == 0xC0) {
+        code_point = lead & 0x1F;
+        length = 2;
+    }
+    else if ((lead & 0xF0) == 0xE0) {
+        code_point = lead & 0x0F;
+        length = 3;
+    }
+    else if ((lead & 0xF8) == 0xF0) {
+        code_point = lead & 0x07;
+        length = 4;
+    }
+    else {
+        return false;
+    }
+
+    if (i + length > text.size())
+        return false;
+
+    for (size_t k = 1; k < length; k++) {
+        uint8_t next = static_cast<uint8_t>(text[i + k]);
+
+        if ((next & 0xC0) != 0x80)
+            return false;
+
+        code_point = (code_point << 6) | (next & 0x3F);
+    }
+
+    i += length;
+    return code_point <= 0x10FFFF;
+}
+
+__forceinline bool is_ascii_letter(uint32_t value) {
+    return (value >= 'a' && value <= 'z') || (value >= 'A' && value <= 'Z');
+}
+
+}
+
+std::optional<text_pattern> text_pattern::compile(std::string_view text, text_encoding encoding, bool case_insensitive)
+{
+    if (text.empty())
+        return std::nullopt;
+
+    text_pattern result;
+    auto& bytes = result._pattern.bytes;
+    auto& masks = result._pattern.masks;
+
+    auto push = [&](uint8_t value, bool letter) {
+        // Upper and lower case ASCII letters only differ in bit 5.
+        uint8_t mask = case_insensitive && letter ? 0xDF : 0xFF;
+        bytes.push_back(value & mask);
+        masks.push_back(mask);
+    };
+
+    size_t i = 0;
+
+    while (i < text.size()) {
+        size_t start = i;
+        uint32_t code_point;
+
+        if (!next_code_point(text, i, code_point))
+            return std::nullopt;
+
+        bool letter = is_ascii_letter(code_point);
+
+        if (encoding == text_encoding::utf8) {
+            for (size_t k = start; k < i; k++)
+                push(static_cast<uint8_t>(text[k]), letter);
+        }
+        else if (code_point < 0x10000) {
+            push(static_cast<uint8_t>(code_point), letter);
+            push(static_cast<uint8_t>(code_point >> 8), false);
+        }
+        else {
+            uint32_t value = code_point - 0x10000;
+            uint16_t units[2] = { static_cast<uint16_t>(0xD800 | (value >> 10)), static_cast<uint16_t>(0xDC00 | (value & 0x3FF)) };
+
+            for (auto unit : units) {
+                push(static_cast<uint8_t>(unit), false);
+                push(static_cast<uint8_t>(unit >> 8), false);
+            }
+        }
+    }
+
+    // Prefer an exact byte other than the zero halves of UTF-16 and spaces, folded letters cost a second pass.
+    auto weight = [&](size_t k) {
+        if (bytes[k] == 0x00 || bytes[k] == ' ')
+            return 2;
+        return masks[k] == 0xFF ? 0 : 1;
+    };
+
+    for (size_t k = 1; k < bytes.size(); k++) {
+        if (weight(k) < weight(result._anchor))
+            result._anchor = k;
+    }
+
+    return result;
+}
+
+void text_pattern::search(const uint8_t* data, size_t size, uint64_t base, std::vector<text_match>& out) const
+{
+    if (size < this->size())
+        return;
+
+    constexpr size_t BLOCK_BYTES = 4096;
+    uint64_t mask[BLOCK_BYTES / 64];
+    uint64_t candidates[BLOCK_BYTES / 64];
+
+    auto kernel = get_compare_kernel<uint8_t>(compare_op::equal);
+
+    uint8_t anchor_value = _pattern.bytes[_anchor];
+    bool folded = _pattern.masks[_anchor] != 0xFF;
+
+    // Anchors are only looked for where the whole pattern fits around them.
+    size_t first = _anchor;
+    size_t last = size - this->size() + _anchor + 1;
+    uint32_t length = static_cast<uint32_t>(this->size());
+
+    for (size_t block = first; block < last; block += BLOCK_BYTES) {
+        size_t count = std::min(BLOCK_BYTES, last - block);
+        size_t words = (count + 63) / 64;
+
+        kernel(data + block, count, anchor_value, anchor_value, candidates);
+
+        if (folded) {
+            kernel(data + block, count, static_cast<uint8_t>(anchor_value | 0x20), 0, mask);
+
+            for (size_t word = 0; word < words; word++)
+                candidates[word] |= mask[word];
+        }
+
+        for (size_t word = 0; word < words; word++) {
+            uint64_t bits = candidates[word];
+
+            while (bits) {
+                size_t start = block + word * 64 + std::countr_zero(bits) - _anchor;
+
+                if (_pattern.matches(data + start))
+                    out.push_back({ base + start, length });
+
+                bits &= bits - 1;
+            }
+        }
+    }
+}
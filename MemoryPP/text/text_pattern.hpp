@@ -0,0 +1,39 @@
+#pragma once
+#include "../platform.hpp"
+#include "../signature/signature.hpp"
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+enum class text_encoding : uint8_t {
+    utf8,
+    utf16le
+};
+
+struct text_match {
+    uint64_t address;
+    uint32_t length;    // In bytes.
+};
+
+// A string compiled to the bytes it takes in memory. Case insensitive patterns fold the ASCII letters
+// by masking out the case bit, other characters are compared exactly.
+class text_pattern {
+    signature _pattern;
+
+    // Byte the search looks for first, and its offset in the pattern. Folded letters are looked
+    // for in both cases.
+    size_t _anchor{ 0 };
+
+public:
+    // text is UTF-8. Fails on empty or malformed text.
+    static std::optional<text_pattern> compile(std::string_view text, text_encoding encoding, bool case_insensitive = false);
+
+    __forceinline size_t size() const { return _pattern.size(); }
+
+    // data must hold at least size() bytes.
+    __forceinline bool matches(const uint8_t* data) const { return _pattern.matches(data); }
+
+    // Appends the matches lying entirely in data, which is mapped at base, ordered by address.
+    void search(const uint8_t* data, size_t size, uint64_t base, std::vector<text_match>& out) const;
+};
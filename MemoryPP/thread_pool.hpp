@@ -0,0 +1,243 @@
+#pragma once
+#include "platform.hpp"
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Work stealing pool. Every worker owns a deque: it pushes and pops its own tasks at the back
+// and steals from the front of the other workers' deques when it runs dry.
+//
+// Tasks carry a priority hint. Priority 0 is the default and goes through the work stealing deques.
+// Positive priorities are kept in a shared queue that is served before any deque, negative ones
+// only run when there is no other work left. The shared queue hands out tasks of the same priority
+// in submission order, the deques give no ordering guarantee.
+class thread_pool {
+    struct priority_operation {
+        int priority;
+        size_t sequence;
+        std::function<void()> task;
+    };
+
+    struct compare_priority {
+        bool operator()(const priority_operation& lhs, const priority_operation& rhs) const {
+            return lhs.priority != rhs.priority ? lhs.priority < rhs.priority : lhs.sequence > rhs.sequence;
+        }
+    };
+
+    struct worker_queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> _queues;
+    std::vector<std::thread> _workers;
+
+    std::mutex _priority_mutex;
+    std::priority_queue<priority_operation, std::vector<priority_operation>, compare_priority> _prioritized;
+    std::atomic<size_t> _prioritized_count{ 0 };
+    size_t _prioritized_sequence{ 0 };
+
+    std::mutex _sleep_mutex;
+    std::condition_variable _sleep_cv;
+    std::atomic<size_t> _queued{ 0 };
+    std::atomic<size_t> _next_queue{ 0 };
+    std::atomic<bool> _done{ false };
+
+    static inline thread_local thread_pool* _current_pool = nullptr;
+    static inline thread_local size_t _current_index = 0;
+
+private:
+    // Pops the top of the shared queue if its priority is at least min_priority.
+    bool pop_prioritized(int min_priority, std::function<void()>& task) {
+        if (_prioritized_count.load() == 0)
+            return false;
+
+        std::lock_guard<std::mutex> lock(_priority_mutex);
+
+        if (_prioritized.empty() || _prioritized.top().priority < min_priority)
+            return false;
+
+        task = std::move(const_cast<priority_operation&>(_prioritized.top()).task);
+        _prioritized.pop();
+        _prioritized_count--;
+        return true;
+    }
+
+    bool pop_local(size_t index, std::function<void()>& task) {
+        auto& queue = *_queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.tasks.empty())
+            return false;
+
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t thief, std::function<void()>& task) {
+        for (size_t i = 1; i <= _queues.size(); i++) {
+            auto& queue = *_queues[(thief + i) % _queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+
+            if (queue.tasks.empty())
+                continue;
+
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void worker_loop(size_t index) {
+        _current_pool = this;
+        _current_index = index;
+
+        while (true) {
+            if (run_one())
+                continue;
+
+            std::unique_lock<std::mutex> lock(_sleep_mutex);
+            _sleep_cv.wait(lock, [this]() { return _queued.load() != 0 || _done.load(); });
+
+            if (_done && _queued.load() == 0)
+                break;
+        }
+    }
+
+public:
+    explicit thread_pool(size_t threads = std::thread::hardware_concurrency()) {
+        if (threads == 0)
+            threads = 1;
+
+        for (size_t i = 0; i < threads; i++)
+            _queues.push_back(std::make_unique<worker_queue>());
+
+        for (size_t i = 0; i < threads; i++)
+            _workers.emplace_back(&thread_pool::worker_loop, this, i);
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+            _done = true;
+        }
+        _sleep_cv.notify_all();
+
+        for (auto& worker : _workers) {
+            if (worker.joinable())
+                worker.join();
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // Process wide pool sized to the hardware, used by default by every engine.
+    static std::shared_ptr<thread_pool> shared() {
+        static auto pool = std::make_shared<thread_pool>();
+        return pool;
+    }
+
+    // Tasks submitted by a worker land in its own deque, others are spread round robin.
+    void submit(std::function<void()> task, int priority = 0) {
+        if (priority != 0) {
+            std::lock_guard<std::mutex> lock(_priority_mutex);
+            _prioritized.push({ priority, _prioritized_sequence++, std::move(task) });
+            _prioritized_count++;
+        }
+        else {
+            size_t index = _current_pool == this ? _current_index : _next_queue++ % _queues.size();
+
+            auto& queue = *_queues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        _queued++;
+
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+        }
+        _sleep_cv.notify_one();
+    }
+
+    // Runs one pending task on the calling thread. Returns false if there was nothing to run.
+    bool run_one() {
+        std::function<void()> task;
+        size_t index = _current_pool == this ? _current_index : 0;
+
+        bool found = pop_prioritized(1, task)
+            || (_current_pool == this && pop_local(index, task))
+            || steal(index, task)
+            || pop_prioritized(INT_MIN, task);
+
+        if (!found)
+            return false;
+
+        _queued--;
+        task();
+        return true;
+    }
+
+    __forceinline size_t size() const { return _workers.size(); }
+
+    // Index of the calling worker in [0, size()), size() for threads outside the pool.
+    // Meant to address per worker buffers, the extra slot belongs to the external threads.
+    __forceinline size_t worker_index() const { return _current_pool == this ? _current_index : _workers.size(); }
+
+    __forceinline bool is_worker() const { return _current_pool == this; }
+};
+
+// Tracks a set of tasks submitted to a pool so the caller can wait for all of them.
+// Tasks may add further tasks to the same group while it is being waited on.
+class task_group {
+    thread_pool& _pool;
+    std::atomic<size_t> _pending{ 0 };
+    std::mutex _mutex;
+    std::condition_variable _cv;
+
+public:
+    explicit task_group(thread_pool& pool) : _pool(pool) {}
+
+    ~task_group() { wait(); }
+
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    void run(std::function<void()> task, int priority = 0) {
+        _pending++;
+
+        _pool.submit([this, task = std::move(task)]() {
+            task();
+
+            // Decrement under the lock so the group cannot be destroyed while it is notified.
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_pending == 0)
+                _cv.notify_all();
+        }, priority);
+    }
+
+    // Blocks until every task of the group has finished.
+    // Workers waiting on a nested group keep executing tasks instead of blocking the pool.
+    void wait() {
+        if (_pool.is_worker()) {
+            while (_pending.load() != 0) {
+                if (!_pool.run_one())
+                    std::this_thread::yield();
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]() { return _pending.load() == 0; });
+    }
+};